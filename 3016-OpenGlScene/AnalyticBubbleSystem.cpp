@@ -0,0 +1,158 @@
+#include "AnalyticBubbleSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+//Cooldown before the first bubble, the same as the CPU simulation's
+const float firstSpawnCooldown = 2.0f;
+
+//--- What a ScheduledEvent's type means here
+enum AnalyticEventType {
+	EVENT_SPAWN,
+	//Target slot's bubble has reached its retire time
+	EVENT_RETIRE
+};
+
+AnalyticBubbleSystem::AnalyticBubbleSystem() {
+}
+
+/// <summary>
+/// Allocates the instance buffer with every slot retired, needs a current GL context
+/// </summary>
+void AnalyticBubbleSystem::Create(size_t capacity) {
+	this->capacity = capacity;
+
+	//Launch time 0 and retire time 0, so an unused slot is hidden for any time
+	vector<float> records(capacity * recordFloats, 0.0f);
+
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, records.size() * sizeof(float), records.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	for (unsigned int slot = 0; slot < capacity; slot++)
+	{
+		freeSlots.push(slot);
+	}
+	events.Reserve(capacity + 1);
+}
+
+void AnalyticBubbleSystem::SeedRandom(uint64_t seed, uint64_t stream) {
+	bubbleRandom.Seed(seed, stream);
+}
+
+/// <summary>
+/// Fires the events now due: frees the slots of retired bubbles and launches a bubble when the cooldown is up.
+/// Only a launch touches the GPU, one record's worth of glBufferSubData.
+/// </summary>
+/// <param name="time">Same clock as the shaders' time uniform</param>
+void AnalyticBubbleSystem::Update(float time) {
+	if (!spawnScheduled)
+	{
+		events.Schedule(time + firstSpawnCooldown / spawnRate, EVENT_SPAWN);
+		spawnScheduled = true;
+	}
+
+	ScheduledEvent event;
+	while (events.PopDue(time, event))
+	{
+		if (event.type == EVENT_RETIRE)
+		{
+			freeSlots.push(event.target.slot);
+			liveCount--;
+			continue;
+		}
+
+		float launchRandoms[BubbleSimulation::launchRandomCount];
+		bubbleRandom.FillFloats(launchRandoms, BubbleSimulation::launchRandomCount);
+
+		BubbleLaunch launch = BubbleSimulation::CreateLaunch(launchRandoms);
+		Spawn(launch, time);
+		events.Schedule(time + launch.cooldown / spawnRate, EVENT_SPAWN);
+	}
+}
+
+/// <summary>
+/// Writes the launch into the lowest free slot and queues its retirement
+/// </summary>
+/// <returns>False when every slot is in use</returns>
+bool AnalyticBubbleSystem::Spawn(const BubbleLaunch& launch, float time) {
+	if (freeSlots.empty())
+	{
+		return false;
+	}
+
+	unsigned int slot = freeSlots.top();
+	freeSlots.pop();
+
+	float retireTime = RetireTime(launch, time);
+	float phase = fract(slot * 0.618034f);
+
+	float record[recordFloats] = {
+		launch.position.x, launch.position.y, launch.position.z, launch.gravityMultiplier,
+		launch.velocity.x, launch.velocity.y, launch.velocity.z, launch.movespeedMultiplier,
+		time, retireTime, phase, 0.0f
+	};
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, slot * recordStride, recordStride, record);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	events.Schedule(retireTime, EVENT_RETIRE, { slot, 0 });
+	liveCount++;
+	highestSlot = std::max(highestSlot, (size_t)slot + 1);
+	return true;
+}
+
+/// <summary>
+/// When the bubble leaves, either the end of its lifetime or the moment its arc crosses y = 0.
+/// Height over time is y0 + vy * (t - a * t^2) with a = 0.5 * g * gravityMultiplier * movespeedMultiplier,
+/// the later root of that quadratic is the ground crossing.
+/// </summary>
+float AnalyticBubbleSystem::RetireTime(const BubbleLaunch& launch, float launchTime) const {
+	float flightTime = lifetime;
+
+	float a = 0.5f * gravity * launch.gravityMultiplier * launch.movespeedMultiplier;
+	float vy = launch.velocity.y;
+	float y0 = launch.position.y;
+
+	if (a > 0.0f && vy != 0.0f)
+	{
+		//vy * a * t^2 - vy * t - y0 = 0
+		float quadratic = vy * a;
+		float discriminant = vy * vy + 4.0f * quadratic * y0;
+		if (discriminant >= 0.0f)
+		{
+			float groundTime = (vy + sqrt(discriminant)) / (2.0f * quadratic);
+			if (groundTime > 0.0f)
+			{
+				flightTime = std::min(flightTime, groundTime);
+			}
+		}
+	}
+
+	return launchTime + flightTime;
+}
+
+unsigned int AnalyticBubbleSystem::GetInstanceBuffer() const {
+	return instanceBuffer;
+}
+
+/// <summary>
+/// Instances to draw, every slot up to the highest ever used. Retired slots in that range are hidden by the shaders.
+/// </summary>
+size_t AnalyticBubbleSystem::GetInstanceCount() const {
+	return highestSlot;
+}
+
+size_t AnalyticBubbleSystem::GetLiveCount() const {
+	return liveCount;
+}
+
+void AnalyticBubbleSystem::CleanUp() {
+	if (instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &instanceBuffer);
+		instanceBuffer = 0;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "BubbleSimulation.h"
+#include "EventScheduler.h"
+#include "PhiloxRandom.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Bubbles that are only ever written once. A spawn writes the launch into a free slot of the instance buffer and the
+/// vertex shaders work out where the bubble is from the time uniform, the same closed form arc as ProjectileParticleStore.
+/// The arc also gives the exact moment the bubble drops below the ground, so every bubble's retire time is known at
+/// launch. Retirements and the next launch are scheduled events, an update only pops the ones now due and frees their
+/// slots, the shaders already hide a bubble past its retire time so nothing is uploaded then either.
+/// </summary>
+class AnalyticBubbleSystem
+{
+public:
+	//--- Record layout, three vec4s per bubble
+	//launchPosition: xyz, w gravity multiplier (read as instanceData by the sphere shaders)
+	//launchVelocity: xyz, w movespeed multiplier
+	//launchTiming: x launch time, y retire time, z phase
+	static const int recordFloats = 12;
+	static const GLsizei recordStride = recordFloats * sizeof(float);
+
+	AnalyticBubbleSystem();
+	void Create(size_t capacity);
+	void SeedRandom(uint64_t seed, uint64_t stream);
+	void Update(float time);
+	bool Spawn(const BubbleLaunch& launch, float time);
+	float RetireTime(const BubbleLaunch& launch, float launchTime) const;
+	void CleanUp();
+
+	unsigned int GetInstanceBuffer() const;
+	size_t GetInstanceCount() const;
+	size_t GetLiveCount() const;
+
+	float gravity = 9.81f;
+	float lifetime = 20.0f;
+	//Launches per cooldown, the CPU simulation's rate is 1
+	float spawnRate = 1.0f;
+
+private:
+	unsigned int instanceBuffer = 0;
+	size_t capacity = 0;
+	//Slots below this have been written at least once, the draw covers them all
+	size_t highestSlot = 0;
+	size_t liveCount = 0;
+
+	//Retirements, target slot is the one to free, and the next launch
+	EventScheduler events;
+	//Kept as a heap too, so the lowest slot is reused first and the draw range stays short
+	priority_queue<unsigned int, vector<unsigned int>, greater<unsigned int>> freeSlots;
+
+	PhiloxRandom bubbleRandom;
+	bool spawnScheduled = false;
+};
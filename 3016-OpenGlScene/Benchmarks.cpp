@@ -0,0 +1,558 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ArcingProjectileObject.h"
+#include "BubbleSimulation.h"
+#include "EventScheduler.h"
+#include "PhiloxRandom.h"
+#include "ProjectileCollisionSystem.h"
+#include "ProjectileParticleStore.h"
+#include "SpatialHashGrid.h"
+
+using namespace std;
+using namespace std::chrono;
+
+//--- Fixed seed so every run times the same launch values
+struct BenchmarkLaunch {
+	vec3 velocity;
+	vec3 position;
+	float gravityMultiplier;
+	float movespeedMultiplier;
+};
+
+static vector<BenchmarkLaunch> CreateBenchmarkLaunches(size_t count) {
+	mt19937 benchmarkGen(3016);
+	uniform_real_distribution<float> benchmarkDis(0.0f, 1.0f);
+
+	vector<BenchmarkLaunch> launches(count);
+	for (BenchmarkLaunch& launch : launches)
+	{
+		launch.position = vec3(-40.0f + 80.0f * benchmarkDis(benchmarkGen), 1.5f + 0.5f * benchmarkDis(benchmarkGen), -40.0f + 30.0f * benchmarkDis(benchmarkGen));
+		launch.velocity = normalize(vec3(benchmarkDis(benchmarkGen) - 0.5f, 1.0f, benchmarkDis(benchmarkGen) - 0.5f)) * 2.0f;
+		launch.gravityMultiplier = 0.04f * benchmarkDis(benchmarkGen);
+		launch.movespeedMultiplier = 0.3f + 0.4f * benchmarkDis(benchmarkGen);
+	}
+	return launches;
+}
+
+static double MillisecondsSince(steady_clock::time_point start) {
+	return duration<double, milli>(steady_clock::now() - start).count();
+}
+
+void RunBenchmarks() {
+	cout << "--- Benchmarks ---" << endl;
+	RunProjectileStoreBenchmark(1000, 600);
+	RunProjectileStoreBenchmark(10000, 600);
+	RunProjectileStoreBenchmark(100000, 120);
+	RunTrajectoryKernelBenchmark(1003, 600);
+	RunTrajectoryKernelBenchmark(100000, 60);
+	RunTrajectoryKernelBenchmark(1000000, 10);
+	RunRandomBenchmark(10000000);
+	RunSpatialHashBenchmark(2000, 60);
+	RunSpatialHashBenchmark(100000, 10);
+	RunSimulationThreadBenchmark(3.0);
+	RunEventSchedulerBenchmark(1000, 1200, 1.0f, 20.0f);
+	RunEventSchedulerBenchmark(100000, 1200, 0.5f, 1.0f);
+	RunEventSchedulerBenchmark(100000, 1200, 1.0f, 20.0f);
+	RunEventSchedulerBenchmark(100000, 1200, 10.0f, 200.0f);
+}
+
+/// <summary>
+/// Times a frame of the old bubble loop, one heap object each updated, tested and erased from a vector when it expires,
+/// against the ProjectileParticleStore doing the same with its batched update and swap removal. Lifetimes are spread over
+/// the second half of the run so the population thins out and every particle has been removed by the end.
+/// Then times removing the same tenth of a full population, every tenth launch, with vector::erase against swap removal.
+/// </summary>
+/// <param name="particleCount">Projectiles launched at the start of the run</param>
+/// <param name="frameCount">Number of 60hz frames to simulate, every particle has expired by the last</param>
+void RunProjectileStoreBenchmark(size_t particleCount, int frameCount) {
+	const float frameTime = 1.0f / 60.0f;
+	vector<BenchmarkLaunch> launches = CreateBenchmarkLaunches(particleCount);
+	float runLength = frameCount * frameTime;
+	//Half a frame short of a frame boundary, so the lifetime test lands on the same frame on both sides.
+	//The low gravity launches come back down within the longer runs too, which removes them a little earlier
+	vector<float> lifetimes(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		lifetimes[i] = runLength * (0.5f + 0.5f * (float)(i + 1) / (float)particleCount) - 0.5f * frameTime;
+	}
+	size_t objectDestroyed = 0;
+	size_t storeDestroyed = 0;
+
+	// ---------------------------
+	// Per object update
+	// ---------------------------
+	vector<ArcingProjectileObject*> projectileObjects;
+	projectileObjects.reserve(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		ArcingProjectileObject* projectileObject = new ArcingProjectileObject();
+		projectileObject->Launch(launches[i].velocity, launches[i].position, 0.0f, launches[i].gravityMultiplier, launches[i].movespeedMultiplier);
+		projectileObject->lifetimeMax = lifetimes[i];
+		projectileObjects.push_back(projectileObject);
+	}
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (size_t i = 0; i < projectileObjects.size();)
+		{
+			ArcingProjectileObject* projectileObject = projectileObjects[i];
+			projectileObject->UpdatePosition(frameTime);
+			if (projectileObject->ShouldDestroy())
+			{
+				delete projectileObject;
+				projectileObjects.erase(projectileObjects.begin() + i);
+				objectDestroyed++;
+			}
+			else {
+				i++;
+			}
+		}
+	}
+	double objectUpdateTime = MillisecondsSince(start) / frameCount;
+
+	// ---------------------------
+	// Structure of arrays update
+	// ---------------------------
+	ProjectileParticleStore projectileParticles(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		projectileParticles.Spawn(launches[i].velocity, launches[i].position, launches[i].gravityMultiplier, launches[i].movespeedMultiplier, lifetimes[i]);
+	}
+
+	vector<unsigned int> destroyedIndices;
+	destroyedIndices.reserve(particleCount);
+
+	start = steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		projectileParticles.UpdatePositions(frameTime, destroyedIndices);
+		//Back to front, a swap removal never moves an index still waiting in the list
+		for (size_t i = destroyedIndices.size(); i > 0; i--)
+		{
+			projectileParticles.RemoveAt(destroyedIndices[i - 1]);
+		}
+		storeDestroyed += destroyedIndices.size();
+	}
+	double storeUpdateTime = MillisecondsSince(start) / frameCount;
+
+	// ---------------------------
+	// Removal, every tenth launch
+	// ---------------------------
+	for (ArcingProjectileObject* projectileObject : projectileObjects)
+	{
+		delete projectileObject;
+	}
+	projectileObjects.clear();
+	projectileParticles.Clear();
+
+	vector<ProjectileHandle> removeHandles;
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		ArcingProjectileObject* projectileObject = new ArcingProjectileObject();
+		projectileObject->Launch(launches[i].velocity, launches[i].position, 0.0f, launches[i].gravityMultiplier, launches[i].movespeedMultiplier);
+		projectileObjects.push_back(projectileObject);
+
+		ProjectileHandle handle = projectileParticles.Spawn(launches[i].velocity, launches[i].position, launches[i].gravityMultiplier, launches[i].movespeedMultiplier);
+		if (i % 10 == 0)
+		{
+			removeHandles.push_back(handle);
+		}
+	}
+
+	//Launch order is the vector's order, so every tenth launch is every tenth index. Front to back as the old loop went,
+	//each erase shifts everything after it down one
+	start = steady_clock::now();
+	for (size_t i = 0; i < projectileObjects.size(); i += 9)
+	{
+		delete projectileObjects[i];
+		projectileObjects.erase(projectileObjects.begin() + i);
+	}
+	double objectRemoveTime = MillisecondsSince(start);
+
+	//Swap removal moves particles around, the handles still find every tenth launch
+	start = steady_clock::now();
+	for (ProjectileHandle handle : removeHandles)
+	{
+		projectileParticles.Remove(handle);
+	}
+	double storeRemoveTime = MillisecondsSince(start);
+
+	size_t objectsLeft = projectileObjects.size();
+	for (ArcingProjectileObject* projectileObject : projectileObjects)
+	{
+		delete projectileObject;
+	}
+
+	cout << particleCount << " projectiles, all expiring over " << frameCount << " frames" << endl;
+	cout << "  update and remove expired per frame   objects: " << objectUpdateTime << " ms   store: " << storeUpdateTime << " ms" << endl;
+	cout << "  expired   objects: " << objectDestroyed << "   store: " << storeDestroyed << endl;
+	cout << "  remove every tenth launch   objects: " << objectRemoveTime << " ms   store: " << storeRemoveTime << " ms" << endl;
+	cout << "  left   objects: " << objectsLeft << "   store: " << projectileParticles.Size() << endl;
+}
+
+/// <summary>
+/// Times the per object UpdatePosition and ShouldDestroy against the batched SIMD kernel, which also emits the
+/// compacted list of destroyed indices. Lifetimes are spread so a share of particles expire during the run.
+/// </summary>
+/// <param name="particleCount">Number of projectiles, an odd count also exercises the scalar tail</param>
+/// <param name="frameCount">Number of 60hz frames to simulate</param>
+void RunTrajectoryKernelBenchmark(size_t particleCount, int frameCount) {
+	const float frameTime = 1.0f / 60.0f;
+	vector<BenchmarkLaunch> launches = CreateBenchmarkLaunches(particleCount);
+	float runLength = frameCount * frameTime;
+	size_t objectDestroyed = 0;
+	size_t kernelDestroyed = 0;
+
+	// ---------------------------
+	// Per object
+	// ---------------------------
+	vector<ArcingProjectileObject*> projectileObjects;
+	projectileObjects.reserve(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		ArcingProjectileObject* projectileObject = new ArcingProjectileObject();
+		projectileObject->Launch(launches[i].velocity, launches[i].position, 0.0f, launches[i].gravityMultiplier, launches[i].movespeedMultiplier);
+		projectileObject->lifetimeMax = runLength * (float)(i % 4 + 1) / 4.0f;
+		projectileObjects.push_back(projectileObject);
+	}
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		for (ArcingProjectileObject* projectileObject : projectileObjects)
+		{
+			projectileObject->UpdatePosition(frameTime);
+			if (projectileObject->ShouldDestroy())
+			{
+				objectDestroyed++;
+			}
+		}
+	}
+	double objectTime = MillisecondsSince(start) / frameCount;
+
+	for (ArcingProjectileObject* projectileObject : projectileObjects)
+	{
+		delete projectileObject;
+	}
+
+	// ---------------------------
+	// Batched kernel
+	// ---------------------------
+	ProjectileParticleStore projectileParticles(particleCount);
+	for (size_t i = 0; i < particleCount; i++)
+	{
+		projectileParticles.Spawn(launches[i].velocity, launches[i].position, launches[i].gravityMultiplier, launches[i].movespeedMultiplier, runLength * (float)(i % 4 + 1) / 4.0f);
+	}
+
+	vector<unsigned int> destroyedIndices;
+	destroyedIndices.reserve(particleCount);
+
+	start = steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		projectileParticles.UpdatePositions(frameTime, destroyedIndices);
+		kernelDestroyed += destroyedIndices.size();
+	}
+	double kernelTime = MillisecondsSince(start) / frameCount;
+
+	int simdLanes = ProjectileParticleStore::GetSimdLanes();
+	const char* kernelWidth = simdLanes == 8 ? "AVX, 8 lanes" : simdLanes == 4 ? "SSE, 4 lanes" : "scalar fallback";
+
+	cout << particleCount << " projectiles, update and destroy test (" << kernelWidth << ")" << endl;
+	cout << "  per frame   objects: " << objectTime << " ms   kernel: " << kernelTime << " ms" << endl;
+	cout << "  destroy flags   objects: " << objectDestroyed << "   kernel: " << kernelDestroyed << endl;
+}
+
+/// <summary>
+/// Times the old mt19937 and uniform_real_distribution draws against PhiloxRandom, one value at a time and batched.
+/// Also checks that two generators with the same seed give the same sequence.
+/// </summary>
+/// <param name="valueCount">Number of uniform floats drawn by each method</param>
+void RunRandomBenchmark(size_t valueCount) {
+	vector<float> values(valueCount);
+
+	mt19937 gen(3016);
+	uniform_real_distribution<> dis(0.0, 1.0);
+
+	steady_clock::time_point start = steady_clock::now();
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		values[i] = (float)dis(gen);
+	}
+	double mersenneTime = MillisecondsSince(start);
+	float checksum = values[valueCount - 1];
+
+	PhiloxRandom singleRandom(3016);
+	start = steady_clock::now();
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		values[i] = singleRandom.NextFloat();
+	}
+	double philoxSingleTime = MillisecondsSince(start);
+	checksum += values[valueCount - 1];
+
+	PhiloxRandom batchRandom(3016);
+	vector<float> batchValues(valueCount);
+	start = steady_clock::now();
+	batchRandom.FillFloats(batchValues.data(), valueCount);
+	double philoxBatchTime = MillisecondsSince(start);
+
+	bool replayMatches = values == batchValues;
+
+	cout << valueCount << " uniform floats" << endl;
+	cout << "  mt19937: " << mersenneTime << " ms   philox single: " << philoxSingleTime << " ms   philox batch: " << philoxBatchTime << " ms" << endl;
+	cout << "  same seed replays identically: " << (replayMatches ? "yes" : "NO") << "   (checksum " << checksum << ")" << endl;
+}
+
+/// <summary>
+/// Times building the spatial hash over moving bubbles and running radius, nearest neighbour and pair queries on it,
+/// then a full collision Resolve on a projectile store of the same size.
+/// Up to 5000 objects the pair count is checked against a brute force O(n^2) pass.
+/// </summary>
+/// <param name="objectCount">Bubbles spread over the scene's spawn area</param>
+/// <param name="frameCount">Number of 60hz frames, the grid is rebuilt and queried every frame</param>
+void RunSpatialHashBenchmark(size_t objectCount, int frameCount) {
+	const float frameTime = 1.0f / 60.0f;
+	const float bubbleRadius = 1.4f;
+	vector<BenchmarkLaunch> launches = CreateBenchmarkLaunches(objectCount);
+
+	//Spread over a volume that keeps roughly the same density of bubbles at every count
+	float areaScale = sqrt((float)objectCount / 100.0f);
+	ProjectileParticleStore projectileParticles(objectCount);
+	for (BenchmarkLaunch& launch : launches)
+	{
+		launch.position.x *= areaScale;
+		launch.position.z *= areaScale;
+		projectileParticles.Spawn(launch.velocity, launch.position, launch.gravityMultiplier, launch.movespeedMultiplier, 1000.0f);
+	}
+
+	SpatialHashGrid grid(bubbleRadius * 2.0f);
+	vector<unsigned int> results;
+	vector<pair<unsigned int, unsigned int>> pairs;
+	size_t radiusHits = 0;
+	size_t nearestFound = 0;
+	size_t pairCount = 0;
+	double buildTime = 0.0;
+	double radiusTime = 0.0;
+	double nearestTime = 0.0;
+	double pairTime = 0.0;
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		projectileParticles.UpdatePositionsScalar(frameTime);
+
+		steady_clock::time_point start = steady_clock::now();
+		grid.Build(projectileParticles.currentPositionX.data(), projectileParticles.currentPositionY.data(), projectileParticles.currentPositionZ.data(), objectCount);
+		buildTime += MillisecondsSince(start);
+
+		start = steady_clock::now();
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			grid.QueryRadius(projectileParticles.PositionAt(i), bubbleRadius * 2.0f, results);
+			radiusHits += results.size();
+		}
+		radiusTime += MillisecondsSince(start);
+
+		start = steady_clock::now();
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			if (grid.FindNearest(projectileParticles.PositionAt(i), 10.0f, (int)i) != -1)
+			{
+				nearestFound++;
+			}
+		}
+		nearestTime += MillisecondsSince(start);
+
+		start = steady_clock::now();
+		grid.FindPairs(bubbleRadius * 2.0f, pairs);
+		pairTime += MillisecondsSince(start);
+		pairCount = pairs.size();
+	}
+
+	// ---------------------------
+	// Brute force check of the last frame's pairs
+	// ---------------------------
+	size_t bruteForcePairs = 0;
+	double bruteForceTime = 0.0;
+	if (objectCount <= 5000)
+	{
+		float contactSquared = bubbleRadius * 2.0f * bubbleRadius * 2.0f;
+		steady_clock::time_point start = steady_clock::now();
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			for (size_t j = i + 1; j < objectCount; j++)
+			{
+				vec3 offset = projectileParticles.PositionAt(j) - projectileParticles.PositionAt(i);
+				if (dot(offset, offset) <= contactSquared)
+				{
+					bruteForcePairs++;
+				}
+			}
+		}
+		bruteForceTime = MillisecondsSince(start);
+	}
+
+	// ---------------------------
+	// Full collision pass
+	// ---------------------------
+	ProjectileCollisionSystem collisionSystem(bubbleRadius);
+	collisionSystem.BuildStatic();
+	size_t contacts = 0;
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		projectileParticles.UpdatePositionsScalar(frameTime);
+		contacts += collisionSystem.Resolve(projectileParticles);
+	}
+	double resolveTime = MillisecondsSince(start) / frameCount;
+
+	cout << objectCount << " bubbles, spatial hash (cell " << grid.GetCellSize() << ")" << endl;
+	cout << "  per frame   build: " << buildTime / frameCount << " ms   radius queries: " << radiusTime / frameCount << " ms   nearest queries: " << nearestTime / frameCount << " ms   pairs: " << pairTime / frameCount << " ms" << endl;
+	cout << "  collision resolve: " << resolveTime << " ms per frame, " << contacts / frameCount << " contacts per frame" << endl;
+	if (objectCount <= 5000)
+	{
+		cout << "  pairs   grid: " << pairCount << "   brute force: " << bruteForcePairs << " (" << bruteForceTime << " ms)" << endl;
+	}
+	cout << "  (radius hits " << radiusHits << ", nearest found " << nearestFound << ")" << endl;
+}
+
+/// <summary>
+/// Runs the bubble simulation thread against a stand in render loop with uneven frame times.
+/// Reports the tick rate the thread actually held, the time spent reading snapshots on the render side,
+/// and the largest step an interpolated bubble took between two frames.
+/// </summary>
+/// <param name="seconds">How long to run for</param>
+void RunSimulationThreadBenchmark(double seconds) {
+	BubbleSimulation bubbleSimulation(1.4f, 60.0);
+	bubbleSimulation.SetMaxBubbles(64);
+	bubbleSimulation.SeedRandom(3016, 1);
+	bubbleSimulation.Start();
+
+	vector<ProjectileHandle> handles;
+	vector<vec3> positions;
+	vector<ProjectileHandle> lastHandles;
+	vector<vec3> lastPositions;
+	double readTime = 0.0;
+	float largestStep = 0.0f;
+	int frames = 0;
+
+	steady_clock::time_point start = steady_clock::now();
+	while (MillisecondsSince(start) < seconds * 1000.0)
+	{
+		steady_clock::time_point readStart = steady_clock::now();
+		bubbleSimulation.ReadInterpolated(handles, positions);
+		readTime += MillisecondsSince(readStart);
+
+		for (size_t i = 0; i < handles.size(); i++)
+		{
+			for (size_t j = 0; j < lastHandles.size(); j++)
+			{
+				if (lastHandles[j].slot == handles[i].slot && lastHandles[j].generation == handles[i].generation)
+				{
+					largestStep = std::max(largestStep, length(positions[i] - lastPositions[j]));
+				}
+			}
+		}
+		lastHandles = handles;
+		lastPositions = positions;
+
+		//Frames alternating between 4ms and 25ms, faster and slower than the 60hz tick
+		this_thread::sleep_for(milliseconds(frames % 2 == 0 ? 4 : 25));
+		frames++;
+	}
+	double elapsed = MillisecondsSince(start) / 1000.0;
+	bubbleSimulation.Stop();
+
+	cout << "Simulation thread, " << elapsed << " s at 60hz against uneven frames" << endl;
+	cout << "  ticks: " << bubbleSimulation.GetTickCount() << " (expected " << (int)(elapsed * 60.0) << ")   frames: " << frames << endl;
+	cout << "  snapshot read per frame: " << readTime / frames << " ms   largest bubble step between frames: " << largestStep << endl;
+}
+
+/// <summary>
+/// Times lifetimes run out the way the bubbles used to, every live ArcingProjectileObject's clock advanced and
+/// ShouldDestroy called on it each frame, against the same lifetimes run out by the event scheduler.
+/// Each object is relaunched with its lifetime again when it ends, so both sides always have objectCount live
+/// and fire the same expiries, bar the odd one the float clocks put a frame either side.
+/// Longer lifetimes fire fewer a frame, polling costs the same however many fire.
+/// </summary>
+/// <param name="objectCount">Live objects for the whole run</param>
+/// <param name="frameCount">Number of 60hz frames to simulate</param>
+/// <param name="minLifetime">Shortest lifetime in seconds</param>
+/// <param name="maxLifetime">Longest lifetime in seconds</param>
+void RunEventSchedulerBenchmark(size_t objectCount, int frameCount, float minLifetime, float maxLifetime) {
+	const double frameTime = 1.0 / 60.0;
+	vector<BenchmarkLaunch> launches = CreateBenchmarkLaunches(objectCount);
+
+	PhiloxRandom lifetimeRandom(3016, 5);
+	vector<float> lifetimes(objectCount);
+	lifetimeRandom.FillRange(lifetimes.data(), objectCount, minLifetime, maxLifetime);
+
+	//--- Polling, every object asked every frame whether it's done. Only its clock is advanced, the trajectory
+	//is needed whichever way expiry is found so it's left out of both sides
+	vector<ArcingProjectileObject*> projectileObjects;
+	projectileObjects.reserve(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		ArcingProjectileObject* projectileObject = new ArcingProjectileObject();
+		projectileObject->Launch(launches[i].velocity, launches[i].position, 0.0f, launches[i].gravityMultiplier, launches[i].movespeedMultiplier);
+		projectileObject->lifetimeMax = lifetimes[i];
+		projectileObjects.push_back(projectileObject);
+	}
+
+	size_t polledExpiries = 0;
+	steady_clock::time_point start = steady_clock::now();
+	for (int frame = 1; frame <= frameCount; frame++)
+	{
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			ArcingProjectileObject* projectileObject = projectileObjects[i];
+			projectileObject->timeSinceStart += (float)frameTime;
+			if (projectileObject->ShouldDestroy())
+			{
+				projectileObject->timeSinceStart = 0.0f;
+				polledExpiries++;
+			}
+		}
+	}
+	double pollingTime = MillisecondsSince(start);
+
+	for (ArcingProjectileObject* projectileObject : projectileObjects)
+	{
+		delete projectileObject;
+	}
+
+	//--- Scheduled, only the expiries that are due are touched
+	EventScheduler events;
+	events.Reserve(objectCount);
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		events.Schedule(lifetimes[i], 0, { (unsigned int)i, 0 });
+	}
+
+	size_t scheduledExpiries = 0;
+	start = steady_clock::now();
+	for (int frame = 1; frame <= frameCount; frame++)
+	{
+		double now = frame * frameTime;
+		ScheduledEvent event;
+		while (events.PopDue(now, event))
+		{
+			events.Schedule(now + lifetimes[event.target.slot], 0, event.target);
+			scheduledExpiries++;
+		}
+	}
+	double schedulerTime = MillisecondsSince(start);
+
+	cout << objectCount << " timed objects, " << minLifetime << "-" << maxLifetime << " s lifetimes, " << frameCount << " frames" << endl;
+	cout << "  polled: " << pollingTime / frameCount << " ms/frame   scheduled: " << schedulerTime / frameCount << " ms/frame   ("
+		<< scheduledExpiries << " expiries, " << polledExpiries << " polled)" << endl;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+
+/// <summary>
+/// Headless timing runs for the simulation code, started with the --benchmark command line argument.
+/// Results are written to the console, nothing here touches OpenGL.
+/// </summary>
+void RunBenchmarks();
+void RunProjectileStoreBenchmark(size_t particleCount, int frameCount);
+void RunTrajectoryKernelBenchmark(size_t particleCount, int frameCount);
+void RunRandomBenchmark(size_t valueCount);
+void RunSpatialHashBenchmark(size_t objectCount, int frameCount);
+void RunSimulationThreadBenchmark(double seconds);
+void RunEventSchedulerBenchmark(size_t objectCount, int frameCount, float minLifetime, float maxLifetime);
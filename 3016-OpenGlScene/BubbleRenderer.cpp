@@ -0,0 +1,190 @@
+#include "BubbleRenderer.h"
+
+//--- Attribute locations the instance data is bound to, see SphereVertexShader.v and SphereImpostorVertexShader.v
+const unsigned int sphereInstanceLocation = 4;
+const unsigned int impostorInstanceLocation = 1;
+const size_t initialInstanceCapacity = 64;
+//Instance data plus the two analytic launch vec4s
+const int maxVec4PerInstance = 3;
+
+BubbleRenderer::BubbleRenderer(unsigned int sphereVAO, int sphereIndicesCount, unsigned int impostorVAO, int impostorIndicesCount) {
+	this->sphereVAO = sphereVAO;
+	this->sphereIndicesCount = sphereIndicesCount;
+	this->impostorVAO = impostorVAO;
+	this->impostorIndicesCount = impostorIndicesCount;
+
+	CreateInstanceBuffer(sphereVAO, meshInstanceBuffer, meshBufferCapacity, sphereInstanceLocation);
+	CreateInstanceBuffer(impostorVAO, impostorInstanceBuffer, impostorBufferCapacity, impostorInstanceLocation);
+}
+
+BubbleRenderer::~BubbleRenderer() {
+
+}
+
+/// <summary>
+/// Creates the per instance buffer and attaches it to the VAO with a divisor of 1.
+/// The buffer starts with space allocated so non instanced draws with the same VAO still read valid memory.
+/// </summary>
+void BubbleRenderer::CreateInstanceBuffer(unsigned int VAO, unsigned int& buffer, size_t& capacity, unsigned int attributeLocation) {
+	capacity = initialInstanceCapacity;
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(vec4), NULL, GL_STREAM_DRAW);
+
+	glBindVertexArray(VAO);
+	glEnableVertexAttribArray(attributeLocation);
+	glVertexAttribPointer(attributeLocation, 4, GL_FLOAT, GL_FALSE, sizeof(vec4), (void*)0);
+	glVertexAttribDivisor(attributeLocation, 1);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// <summary>
+/// Clears last frame's instances, the vectors keep their memory
+/// </summary>
+void BubbleRenderer::BeginFrame() {
+	meshInstances.clear();
+	impostorInstances.clear();
+}
+
+void BubbleRenderer::AddBubble(vec3 position, float phase, bool asImpostor) {
+	if (asImpostor)
+	{
+		impostorInstances.push_back(vec4(position, phase));
+	}
+	else {
+		meshInstances.push_back(vec4(position, phase));
+	}
+}
+
+/// <summary>
+/// Orphans the buffer and writes this frame's instances into it. Grows by doubling when the bubble count outgrows it.
+/// </summary>
+void BubbleRenderer::UploadInstances(unsigned int buffer, size_t& capacity, const vector<vec4>& instances) {
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	while (capacity < instances.size())
+	{
+		capacity *= 2;
+	}
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(vec4), instances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// <summary>
+/// Uploads and draws all bubbles added this frame. Texture uniforms are expected to be set on both shaders beforehand,
+/// time and the camera come from FrameUniforms.
+/// </summary>
+void BubbleRenderer::Draw(Shader& sphereShader, Shader& impostorShader) {
+	if (!meshInstances.empty())
+	{
+		UploadInstances(meshInstanceBuffer, meshBufferCapacity, meshInstances);
+
+		sphereShader.Use();
+		glBindVertexArray(sphereVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, sphereIndicesCount, GL_UNSIGNED_INT, 0, (GLsizei)meshInstances.size());
+	}
+
+	if (!impostorInstances.empty())
+	{
+		UploadInstances(impostorInstanceBuffer, impostorBufferCapacity, impostorInstances);
+
+		impostorShader.Use();
+		glBindVertexArray(impostorVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, impostorIndicesCount, GL_UNSIGNED_INT, 0, (GLsizei)impostorInstances.size());
+	}
+
+	glBindVertexArray(0);
+}
+
+/// <summary>
+/// Draws instances straight out of a buffer the CPU never fills, the GPU simulation's records for instance.
+/// Both VAOs are pointed at the buffer for these draws and back at their own buffers afterwards.
+/// Both shaders see every instance and each drops the ones on the other side of impostorDistance.
+/// </summary>
+/// <param name="stride">Bytes between instances, the vec4 is read from the start of each</param>
+/// <param name="impostorDistance">Split between full meshes and impostors, 0 or less draws only meshes</param>
+/// <param name="vec4PerInstance">Consecutive vec4s bound from each instance, to the instance location and the ones after it</param>
+void BubbleRenderer::DrawFromBuffer(Shader& sphereShader, Shader& impostorShader, unsigned int instanceBuffer, GLsizei stride, size_t instanceCount, float impostorDistance, int vec4PerInstance) {
+	bool withImpostors = impostorDistance > 0.0f;
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	sphereShader.Use();
+	sphereShader.setBool("splitByDistance", withImpostors);
+	sphereShader.setFloat("impostorDistance", impostorDistance);
+	PointInstanceAttributes(sphereVAO, sphereInstanceLocation, stride, vec4PerInstance);
+	glDrawElementsInstanced(GL_TRIANGLES, sphereIndicesCount, GL_UNSIGNED_INT, 0, (GLsizei)instanceCount);
+
+	if (withImpostors)
+	{
+		impostorShader.Use();
+		impostorShader.setBool("splitByDistance", true);
+		impostorShader.setFloat("impostorDistance", impostorDistance);
+		PointInstanceAttributes(impostorVAO, impostorInstanceLocation, stride, vec4PerInstance);
+		glDrawElementsInstanced(GL_TRIANGLES, impostorIndicesCount, GL_UNSIGNED_INT, 0, (GLsizei)instanceCount);
+	}
+
+	//--- Back to the renderer's own buffers for Draw
+	glBindBuffer(GL_ARRAY_BUFFER, meshInstanceBuffer);
+	PointInstanceAttributes(sphereVAO, sphereInstanceLocation, sizeof(vec4), 1);
+	glBindBuffer(GL_ARRAY_BUFFER, impostorInstanceBuffer);
+	PointInstanceAttributes(impostorVAO, impostorInstanceLocation, sizeof(vec4), 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	sphereShader.Use();
+	sphereShader.setBool("splitByDistance", false);
+	impostorShader.Use();
+	impostorShader.setBool("splitByDistance", false);
+}
+
+/// <summary>
+/// Points the VAO's instance attribute, and vec4PerInstance - 1 locations after it, at the bound array buffer.
+/// Locations past the first are disabled again when only one is asked for.
+/// </summary>
+void BubbleRenderer::PointInstanceAttributes(unsigned int VAO, unsigned int attributeLocation, GLsizei stride, int vec4PerInstance) {
+	glBindVertexArray(VAO);
+	glVertexAttribPointer(attributeLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)0);
+
+	for (int extra = 1; extra < maxVec4PerInstance; extra++)
+	{
+		unsigned int location = attributeLocation + extra;
+		if (extra < vec4PerInstance)
+		{
+			glEnableVertexAttribArray(location);
+			glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(extra * sizeof(vec4)));
+			glVertexAttribDivisor(location, 1);
+		}
+		else {
+			glDisableVertexAttribArray(location);
+		}
+	}
+}
+
+size_t BubbleRenderer::GetMeshInstanceCount() {
+	return meshInstances.size();
+}
+
+size_t BubbleRenderer::GetImpostorInstanceCount() {
+	return impostorInstances.size();
+}
+
+/// <summary>
+/// Deletes both instance buffers
+/// </summary>
+void BubbleRenderer::CleanUp() {
+	if (meshInstanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &meshInstanceBuffer);
+		meshInstanceBuffer = 0;
+	}
+
+	if (impostorInstanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &impostorInstanceBuffer);
+		impostorInstanceBuffer = 0;
+	}
+}
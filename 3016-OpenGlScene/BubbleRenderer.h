@@ -0,0 +1,50 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Draws every live bubble with one instanced call for the full meshes and one for the impostor quads.
+/// Bubbles are added each frame with AddBubble, then Draw uploads both instance lists and issues the draws.
+/// Instance data is a vec4 per bubble, xyz is the world position and w is its noise phase.
+/// DrawFromBuffer draws instances already sitting in another buffer instead, such as the GPU simulation's.
+/// </summary>
+class BubbleRenderer
+{
+public:
+	BubbleRenderer(unsigned int sphereVAO, int sphereIndicesCount, unsigned int impostorVAO, int impostorIndicesCount);
+	~BubbleRenderer();
+	void BeginFrame();
+	void AddBubble(vec3 position, float phase, bool asImpostor);
+	void Draw(Shader& sphereShader, Shader& impostorShader);
+	void DrawFromBuffer(Shader& sphereShader, Shader& impostorShader, unsigned int instanceBuffer, GLsizei stride, size_t instanceCount, float impostorDistance, int vec4PerInstance = 1);
+	void CleanUp();
+	size_t GetMeshInstanceCount();
+	size_t GetImpostorInstanceCount();
+
+private:
+	unsigned int sphereVAO;
+	unsigned int impostorVAO;
+	int sphereIndicesCount;
+	int impostorIndicesCount;
+
+	vector<vec4> meshInstances;
+	vector<vec4> impostorInstances;
+
+	unsigned int meshInstanceBuffer = 0;
+	unsigned int impostorInstanceBuffer = 0;
+	size_t meshBufferCapacity = 0;
+	size_t impostorBufferCapacity = 0;
+
+	void CreateInstanceBuffer(unsigned int VAO, unsigned int& buffer, size_t& capacity, unsigned int attributeLocation);
+	void UploadInstances(unsigned int buffer, size_t& capacity, const vector<vec4>& instances);
+	void PointInstanceAttributes(unsigned int VAO, unsigned int attributeLocation, GLsizei stride, int vec4PerInstance);
+};
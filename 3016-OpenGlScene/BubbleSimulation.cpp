@@ -0,0 +1,407 @@
+#include "BubbleSimulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std::chrono;
+
+//Ticks the simulation may fall behind before it gives up catching up and drops them
+const int maxCatchUpTicks = 5;
+
+//Cooldown before the first bubble
+const float firstSpawnCooldown = 2.0f;
+
+//Bubbles outside the full rate budget drift once every this many ticks
+const unsigned int reducedRateTicks = 4;
+
+//--- What a ScheduledEvent's type means to the simulation
+enum BubbleEventType {
+	EVENT_SPAWN,
+	//Target is the bubble whose lifetime is up
+	EVENT_EXPIRE
+};
+
+BubbleSimulation::BubbleSimulation(float bubbleRadius, double ticksPerSecond)
+	: collisionSystem(bubbleRadius), bubbleRadius(bubbleRadius), running(false), publishedTicks(0) {
+	tickInterval = 1.0 / ticksPerSecond;
+	events.Schedule(firstSpawnCooldown, EVENT_SPAWN);
+}
+
+BubbleSimulation::~BubbleSimulation() {
+	Stop();
+}
+
+void BubbleSimulation::SetMaxBubbles(size_t maxBubbles) {
+	this->maxBubbles = maxBubbles;
+	projectileParticles.Reserve(maxBubbles);
+	destroyedIndices.reserve(maxBubbles);
+	driftIndices.reserve(maxBubbles);
+	for (vector<float>* scratch : { &driftX, &driftY, &driftZ, &windX, &windY, &windZ })
+	{
+		scratch->reserve(maxBubbles);
+	}
+	significancePositions.reserve(maxBubbles);
+	//One expiry per bubble, plus the next spawn and keyframe, and stale expiries of bubbles that hit the ground
+	events.Reserve(maxBubbles * 2 + 2);
+	tickChanges.reserve(maxBubbles * 2);
+	for (BubbleSnapshot* snapshot : { &building, &previous, &latest })
+	{
+		snapshot->handles.reserve(maxBubbles);
+		snapshot->positions.reserve(maxBubbles);
+	}
+}
+
+void BubbleSimulation::SeedRandom(uint64_t seed, uint64_t stream) {
+	bubbleRandom.Seed(seed, stream);
+}
+
+/// <summary>
+/// Wind the bubbles drift on, NULL for pure arcs. Must be baked before Start and left alone while running.
+/// </summary>
+void BubbleSimulation::SetWindField(const WindField* windField) {
+	this->windField = windField;
+}
+
+void BubbleSimulation::SetMaxFullRateUpdates(size_t maxFullRateUpdates) {
+	significance.maxFullRateUpdates = maxFullRateUpdates;
+}
+
+/// <summary>
+/// Camera the drift rate is decided from, called by the render loop each frame. Safe while running.
+/// </summary>
+/// <param name="projectionScale">See SignificanceManager::SetViewpoint</param>
+void BubbleSimulation::SetViewpoint(vec3 position, vec3 forward, float projectionScale) {
+	lock_guard<mutex> lock(viewpointMutex);
+	viewpointPosition = position;
+	viewpointForward = forward;
+	viewpointProjectionScale = projectionScale;
+}
+
+/// <summary>
+/// Static colliders are added through this before Start, the simulation thread owns it afterwards
+/// </summary>
+ProjectileCollisionSystem& BubbleSimulation::GetCollisionSystem() {
+	return collisionSystem;
+}
+
+void BubbleSimulation::Start() {
+	if (running)
+	{
+		return;
+	}
+
+	collisionSystem.BuildStatic();
+
+	//Publish the starting state twice so the first read has two snapshots to interpolate between
+	Publish();
+	Publish();
+
+	running = true;
+	simulationThread = thread(&BubbleSimulation::Run, this);
+}
+
+void BubbleSimulation::Stop() {
+	running = false;
+	if (simulationThread.joinable())
+	{
+		simulationThread.join();
+	}
+}
+
+bool BubbleSimulation::IsRunning() const {
+	return running;
+}
+
+/// <summary>
+/// Sleeps to each tick's due time. Deadlines are stepped by whole ticks, so the rate holds over time
+/// even when a single sleep runs long.
+/// </summary>
+void BubbleSimulation::Run() {
+	steady_clock::duration tickDuration = duration_cast<steady_clock::duration>(duration<double>(tickInterval));
+	steady_clock::time_point nextTick = steady_clock::now();
+
+	while (running)
+	{
+		Tick();
+
+		nextTick += tickDuration;
+		steady_clock::time_point now = steady_clock::now();
+		if (now - nextTick > tickDuration * maxCatchUpTicks)
+		{
+			//Too far behind (a breakpoint, the window being dragged), carry on from now instead of rushing
+			nextTick = now;
+		}
+		this_thread::sleep_until(nextTick);
+	}
+}
+
+/// <summary>
+/// One fixed step, then publishes the result. Called by the simulation thread, or directly when not started.
+/// </summary>
+void BubbleSimulation::Tick() {
+	float deltaTime = (float)tickInterval;
+	//Time at the end of this tick, anything scheduled up to here happens in it
+	double now = (tick + 1) * tickInterval;
+
+	// ------------------------
+	// Timed events
+	// ------------------------
+	if (spawnWaiting && projectileParticles.Size() < maxBubbles)
+	{
+		spawnWaiting = false;
+		SpawnBubble(now);
+	}
+
+	ScheduledEvent event;
+	while (events.PopDue(now, event))
+	{
+		FireEvent(event, now);
+	}
+
+	// ------------------------
+	// Trajectories and ground contact
+	// ------------------------
+	//Lifetimes are left to the expiry events, so the store only ever flags bubbles below the ground
+	projectileParticles.UpdatePositions(deltaTime, destroyedIndices);
+
+	//Back to front, so the bubble swapped into each hole is always one that survives
+	for (size_t d = destroyedIndices.size(); d-- > 0;)
+	{
+		RemoveBubble(destroyedIndices[d]);
+	}
+
+	// ------------------------
+	// Wind drift
+	// ------------------------
+	size_t count = projectileParticles.Size();
+	if (windField != NULL && count > 0)
+	{
+		{
+			lock_guard<mutex> lock(viewpointMutex);
+			significance.SetViewpoint(viewpointPosition, viewpointForward, viewpointProjectionScale);
+		}
+
+		significancePositions.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			significancePositions[i] = projectileParticles.PositionAt(i);
+		}
+		significance.Evaluate(significancePositions, bubbleRadius);
+
+		//Reduced rate bubbles are spread over the ticks by slot, so they don't all come due on the same one
+		driftIndices.clear();
+		driftX.clear();
+		driftY.clear();
+		driftZ.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (significance.Get(i).fullRate || (tick + projectileParticles.HandleAt(i).slot) % reducedRateTicks == 0)
+			{
+				driftIndices.push_back((unsigned int)i);
+				driftX.push_back(projectileParticles.currentPositionX[i]);
+				driftY.push_back(projectileParticles.currentPositionY[i]);
+				driftZ.push_back(projectileParticles.currentPositionZ[i]);
+			}
+		}
+
+		//One baked lookup per drifting bubble
+		size_t driftCount = driftIndices.size();
+		windX.resize(driftCount);
+		windY.resize(driftCount);
+		windZ.resize(driftCount);
+		windField->SampleBatch(driftX.data(), driftY.data(), driftZ.data(), driftCount, windX.data(), windY.data(), windZ.data());
+
+		for (size_t d = 0; d < driftCount; d++)
+		{
+			unsigned int i = driftIndices[d];
+			float driftTime = significance.Get(i).fullRate ? deltaTime : deltaTime * reducedRateTicks;
+			projectileParticles.Translate(i, vec3(windX[d], windY[d], windZ[d]) * driftTime);
+		}
+	}
+
+	collisionSystem.Resolve(projectileParticles);
+
+	tick++;
+	Publish();
+}
+
+void BubbleSimulation::FireEvent(const ScheduledEvent& event, double now) {
+	switch (event.type)
+	{
+	case EVENT_SPAWN:
+		if (projectileParticles.Size() < maxBubbles)
+		{
+			SpawnBubble(now);
+		}
+		else {
+			spawnWaiting = true;
+		}
+		break;
+
+	case EVENT_EXPIRE:
+		//Stale when the bubble already hit the ground, its slot may have a newer bubble in it by now
+		if (projectileParticles.IsAlive(event.target))
+		{
+			RemoveBubble(projectileParticles.IndexOf(event.target));
+		}
+		break;
+	}
+}
+
+/// <summary>
+/// Launch values are drawn in one batch per bubble, the same nine values in the same order as before the
+/// simulation moved off the main thread, so a seed gives the same bubbles.
+/// The bubble's expiry and the next spawn are scheduled here, the only time either changes.
+/// </summary>
+void BubbleSimulation::SpawnBubble(double now) {
+	float launchRandoms[launchRandomCount];
+	bubbleRandom.FillFloats(launchRandoms, launchRandomCount);
+
+	BubbleLaunch launch = CreateLaunch(launchRandoms);
+	ProjectileHandle handle = projectileParticles.Spawn(launch.velocity, launch.position, launch.gravityMultiplier, launch.movespeedMultiplier,
+		numeric_limits<float>::infinity());
+
+	events.Schedule(now + lifetime, EVENT_EXPIRE, handle);
+	events.Schedule(now + launch.cooldown, EVENT_SPAWN);
+	tickChanges.push_back({ handle, true });
+}
+
+void BubbleSimulation::RemoveBubble(size_t index) {
+	tickChanges.push_back({ projectileParticles.HandleAt(index), false });
+	projectileParticles.RemoveAt(index);
+}
+
+/// <summary>
+/// Maps uniform 0-1 values to a launch inside the spawn area. Shared by every bubble simulation mode
+/// so they all launch bubbles the same way.
+/// </summary>
+BubbleLaunch BubbleSimulation::CreateLaunch(const float launchRandoms[launchRandomCount]) {
+	const float PI = acos(-1.0f);
+	BubbleLaunch launch;
+
+	//--- Spawn bounds
+	vec3 topLeft = vec3(-40.0f, -0.1f, -40.0f);
+	vec3 bottomRight = vec3(40.0f, -0.1f, -10.0f);
+
+	float ySpawnValueMin = 1.5f;
+	float ySpawnValue = ySpawnValueMin + (2.0f - ySpawnValueMin) * launchRandoms[0];
+
+	float randomX = topLeft.x + (bottomRight.x - topLeft.x) * launchRandoms[1];
+	float randomZ = topLeft.z + (bottomRight.z - topLeft.z) * launchRandoms[2];
+	launch.position = vec3(randomX, ySpawnValue, randomZ);
+
+	//--- Launch angle
+	//Angle when looking down the y axis
+	float azimuth = launchRandoms[3] * 2 * PI;
+
+	//Phi is the vertical angle from the horizontal plane, 30 to 80 degrees
+	float minPhi = PI / 6;
+	float maxPhi = 4 * PI / 9;
+	float phi = minPhi + (maxPhi - minPhi) * launchRandoms[4];
+
+	launch.velocity = normalize(vec3(sin(phi) * cos(azimuth), cos(phi), sin(phi) * sin(azimuth)));
+
+	float initVelMin = 1.8f;
+	launch.velocity *= initVelMin + (2.2f - initVelMin) * launchRandoms[5];
+
+	//--- Speed and gravity multipliers
+	float speedMin = 0.3f;
+	launch.movespeedMultiplier = speedMin + (0.7f - speedMin) * launchRandoms[6];
+	float gravityMultiMin = 0.0f;
+	launch.gravityMultiplier = gravityMultiMin + (0.04f - gravityMultiMin) * launchRandoms[7];
+
+	//Random spawn cooldown
+	float cooldownMin = 2.0f;
+	launch.cooldown = cooldownMin + (4.0f - cooldownMin) * launchRandoms[8];
+
+	return launch;
+}
+
+/// <summary>
+/// Copies the store into the spare snapshot, then under the lock the latest becomes previous and the spare becomes
+/// latest. The old previous is left as the next spare, so after warm up publishing never allocates.
+/// </summary>
+void BubbleSimulation::Publish() {
+	size_t count = projectileParticles.Size();
+
+	building.tick = tick;
+	building.simulationTime = tick * tickInterval;
+	building.handles.resize(count);
+	building.positions.resize(count);
+
+	unsigned int slotCount = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		building.handles[i] = projectileParticles.HandleAt(i);
+		building.positions[i] = projectileParticles.PositionAt(i);
+		slotCount = std::max(slotCount, building.handles[i].slot + 1);
+	}
+
+	building.slotToIndex.assign(slotCount, -1);
+	for (size_t i = 0; i < count; i++)
+	{
+		building.slotToIndex[building.handles[i].slot] = (int)i;
+	}
+
+	building.publishTime = steady_clock::now();
+
+	{
+		lock_guard<mutex> lock(snapshotMutex);
+		swap(previous, latest);
+		swap(latest, building);
+
+		pendingChanges.insert(pendingChanges.end(), tickChanges.begin(), tickChanges.end());
+	}
+	tickChanges.clear();
+	publishedTicks = tick;
+}
+
+/// <summary>
+/// Bubble positions blended between the previous and latest snapshot by how far the clock is through the tick
+/// since the latest was published. A bubble that only exists in the latest snapshot is drawn where it is.
+/// </summary>
+/// <param name="handles">Filled with the handle of every live bubble</param>
+/// <param name="positions">Filled with the matching interpolated positions</param>
+/// <param name="changes">Filled with the bubbles spawned and removed up to the latest snapshot since the last read.
+/// Leave as NULL to throw them away.</param>
+void BubbleSimulation::ReadInterpolated(vector<ProjectileHandle>& handles, vector<vec3>& positions, vector<BubbleChange>* changes) {
+	lock_guard<mutex> lock(snapshotMutex);
+
+	if (changes != NULL)
+	{
+		changes->assign(pendingChanges.begin(), pendingChanges.end());
+	}
+	pendingChanges.clear();
+
+	double sincePublish = duration<double>(steady_clock::now() - latest.publishTime).count();
+	float alpha = (float)std::min(std::max(sincePublish / tickInterval, 0.0), 1.0);
+
+	size_t count = latest.handles.size();
+	handles.resize(count);
+	positions.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		ProjectileHandle handle = latest.handles[i];
+		handles[i] = handle;
+		positions[i] = latest.positions[i];
+
+		if (handle.slot < previous.slotToIndex.size())
+		{
+			int previousIndex = previous.slotToIndex[handle.slot];
+			if (previousIndex != -1 && previous.handles[previousIndex].generation == handle.generation)
+			{
+				positions[i] = mix(previous.positions[previousIndex], latest.positions[i], alpha);
+			}
+		}
+	}
+}
+
+double BubbleSimulation::GetTickInterval() const {
+	return tickInterval;
+}
+
+uint64_t BubbleSimulation::GetTickCount() const {
+	return publishedTicks;
+}
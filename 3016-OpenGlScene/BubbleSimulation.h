@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "EventScheduler.h"
+#include "PhiloxRandom.h"
+#include "ProjectileCollisionSystem.h"
+#include "ProjectileParticleStore.h"
+#include "SignificanceManager.h"
+#include "WindField.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Launch values for one bubble and the wait before the next, made from one batch of random values
+/// </summary>
+struct BubbleLaunch
+{
+	vec3 position;
+	vec3 velocity;
+	float gravityMultiplier;
+	float movespeedMultiplier;
+	float cooldown;
+};
+
+/// <summary>
+/// Everything the render loop needs from one simulation tick, copied out so the simulation can carry on
+/// </summary>
+struct BubbleSnapshot
+{
+	uint64_t tick = 0;
+	double simulationTime = 0.0;
+	chrono::steady_clock::time_point publishTime;
+
+	//One entry per live bubble
+	vector<ProjectileHandle> handles;
+	vector<vec3> positions;
+	//Slot -> index into the arrays above, -1 when the slot has no bubble this tick
+	vector<int> slotToIndex;
+};
+
+/// <summary>
+/// A bubble coming or going, handed to the render loop so it can start and stop the bubble's sound and light
+/// without comparing whole snapshots. Kept in the order they happened, so a popped bubble always comes before
+/// a new one reusing its slot.
+/// </summary>
+struct BubbleChange
+{
+	ProjectileHandle handle;
+	bool spawned;
+};
+
+/// <summary>
+/// Bubble simulation on its own thread at a fixed tick rate. Each tick fires the scheduled events that are due (spawns and
+/// lifetimes running out), advances every trajectory by exactly one tick, removes the bubbles
+/// that hit the ground, drifts the rest on the wind and resolves collisions. Only the bubbles most significant to the
+/// camera drift every tick, the rest drift every few ticks by that many ticks' worth.
+/// Results go out as snapshots: the thread fills a spare one and swaps it in as the latest, the render loop reads the
+/// latest two and interpolates between them, so it draws one tick behind but always moves smoothly.
+/// Trajectories no longer depend on the frame rate, and the simulation runs on a separate core from rendering.
+/// </summary>
+class BubbleSimulation
+{
+public:
+	BubbleSimulation(float bubbleRadius, double ticksPerSecond = 60.0);
+	~BubbleSimulation();
+
+	//--- Setup, before Start
+	void SetMaxBubbles(size_t maxBubbles);
+	void SeedRandom(uint64_t seed, uint64_t stream);
+	void SetWindField(const WindField* windField);
+	void SetMaxFullRateUpdates(size_t maxFullRateUpdates);
+	ProjectileCollisionSystem& GetCollisionSystem();
+
+	void Start();
+	void Stop();
+	bool IsRunning() const;
+	void Tick();
+
+	void SetViewpoint(vec3 position, vec3 forward, float projectionScale);
+	void ReadInterpolated(vector<ProjectileHandle>& handles, vector<vec3>& positions, vector<BubbleChange>* changes = NULL);
+	double GetTickInterval() const;
+	uint64_t GetTickCount() const;
+
+	static const int launchRandomCount = 9;
+	static BubbleLaunch CreateLaunch(const float launchRandoms[launchRandomCount]);
+
+private:
+	//--- Owned by the simulation thread once started
+	ProjectileParticleStore projectileParticles;
+	ProjectileCollisionSystem collisionSystem;
+	vector<unsigned int> destroyedIndices;
+	//Baked before Start and never changed after, so reading it from this thread needs no lock
+	const WindField* windField = NULL;
+	float bubbleRadius;
+	//Drifting this tick, their gathered positions, then the wind sampled at them
+	vector<unsigned int> driftIndices;
+	vector<float> driftX;
+	vector<float> driftY;
+	vector<float> driftZ;
+	vector<float> windX;
+	vector<float> windY;
+	vector<float> windZ;
+
+	//Decides which bubbles drift at the full rate
+	SignificanceManager significance;
+	vector<vec3> significancePositions;
+	//Set by the render loop, guarded by viewpointMutex
+	vec3 viewpointPosition = vec3(0.0f);
+	vec3 viewpointForward = vec3(0.0f, 0.0f, -1.0f);
+	float viewpointProjectionScale = 1.0f;
+	mutex viewpointMutex;
+	PhiloxRandom bubbleRandom;
+	size_t maxBubbles = 7;
+	float lifetime = 20.0f;
+	uint64_t tick = 0;
+	double tickInterval;
+
+	//Spawns and expiries, in simulation seconds
+	EventScheduler events;
+	//A spawn came due while the simulation was full, it goes ahead on the first tick with room
+	bool spawnWaiting = false;
+	//Bubbles spawned and removed this tick, handed to pendingChanges when published
+	vector<BubbleChange> tickChanges;
+
+	//--- Snapshots, building is only touched by the simulation thread, the other two are guarded by snapshotMutex
+	BubbleSnapshot building;
+	BubbleSnapshot previous;
+	BubbleSnapshot latest;
+	mutable mutex snapshotMutex;
+	//Changes published since the last read, guarded by snapshotMutex
+	vector<BubbleChange> pendingChanges;
+
+	thread simulationThread;
+	atomic<bool> running;
+	atomic<uint64_t> publishedTicks;
+
+	void Run();
+	void FireEvent(const ScheduledEvent& event, double now);
+	void SpawnBubble(double now);
+	void RemoveBubble(size_t index);
+	void Publish();
+};
@@ -0,0 +1,235 @@
+#include "DeferredRenderer.h"
+
+#include <iostream>
+
+//--- Formats of the G-buffer targets. Position keeps full float precision so the light pass shades the same point
+//the forward shaders do, the rest are directions and colours.
+//gPosition, gNormal (w shininess), gDiffuse, gSpecular, gAmbient
+const GLenum gBufferFormats[] = { GL_RGBA32F, GL_RGBA16F, GL_RGBA8, GL_RGBA8, GL_RGBA8 };
+const GLenum gBufferTypes[] = { GL_FLOAT, GL_FLOAT, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE };
+const char* gBufferSamplers[] = { "gPosition", "gNormal", "gDiffuse", "gSpecular", "gAmbient" };
+
+DeferredRenderer::DeferredRenderer() {
+}
+
+DeferredRenderer::~DeferredRenderer() {
+	delete lightShader;
+}
+
+/// <summary>
+/// Creates both framebuffers, the light volume mesh and the light pass shader. Needs a current GL context.
+/// </summary>
+/// <param name="firstTextureUnit">The G-buffer targets take this unit and the next four while the light pass reads them</param>
+/// <param name="pointLightTextureUnit">Unit PointLightBuffer's texture is bound to</param>
+void DeferredRenderer::Create(int width, int height, int firstTextureUnit, int pointLightTextureUnit, const FrameUniformBuffer& frameUniforms) {
+	this->width = width;
+	this->height = height;
+	this->firstTextureUnit = firstTextureUnit;
+
+	colourTexture = CreateTarget();
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		gBufferTextures[i] = CreateTarget();
+	}
+	glGenRenderbuffers(1, &depthRenderbuffer);
+	AllocateTargets();
+
+	GLenum drawBuffers[gBufferTargets + 1];
+	glGenFramebuffers(1, &geometryFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, geometryFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colourTexture, 0);
+	drawBuffers[0] = GL_COLOR_ATTACHMENT0;
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1 + i, GL_TEXTURE_2D, gBufferTextures[i], 0);
+		drawBuffers[i + 1] = GL_COLOR_ATTACHMENT1 + i;
+	}
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+	glDrawBuffers(gBufferTargets + 1, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cerr << "Deferred geometry framebuffer is not complete" << endl;
+	}
+
+	//Shares the colour and depth, but the G-buffer isn't attached so the light pass can sample it
+	glGenFramebuffers(1, &lightFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, lightFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colourTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cerr << "Deferred light framebuffer is not complete" << endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	CreateVolume();
+
+	lightShader = new Shader("Shaders/DeferredLightVertexShader.v", "Shaders/DeferredLightFragmentShader.f");
+	frameUniforms.Attach(*lightShader);
+	lightShader->Use();
+	lightShader->setInt("pointLightData", pointLightTextureUnit);
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		lightShader->setInt(gBufferSamplers[i], firstTextureUnit + i);
+	}
+}
+
+/// <summary>
+/// Gives every target storage for a new framebuffer size, the framebuffers keep them attached
+/// </summary>
+void DeferredRenderer::Resize(int width, int height) {
+	if (width == this->width && height == this->height)
+	{
+		return;
+	}
+	this->width = width;
+	this->height = height;
+	AllocateTargets();
+}
+
+/// <summary>
+/// Storage for the colour, the G-buffer and the depth at the current width and height
+/// </summary>
+void DeferredRenderer::AllocateTargets() {
+	glBindTexture(GL_TEXTURE_2D, colourTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, gBufferTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, gBufferFormats[i], width, height, 0, GL_RGBA, gBufferTypes[i], NULL);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	//The forward draws that come after depth test against this once it is blitted, so it matches the screen's format
+	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
+/// <summary>
+/// Screen sized target with nearest filtering, the light pass reads it a texel at a time. AllocateTargets gives it storage
+/// </summary>
+unsigned int DeferredRenderer::CreateTarget() {
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+/// <summary>
+/// Cube from -1 to 1 wound outwards, the vertex shader scales it by the light's range
+/// </summary>
+void DeferredRenderer::CreateVolume() {
+	float corners[] = {
+		-1.0f, -1.0f, -1.0f,
+		 1.0f, -1.0f, -1.0f,
+		 1.0f,  1.0f, -1.0f,
+		-1.0f,  1.0f, -1.0f,
+		-1.0f, -1.0f,  1.0f,
+		 1.0f, -1.0f,  1.0f,
+		 1.0f,  1.0f,  1.0f,
+		-1.0f,  1.0f,  1.0f
+	};
+	unsigned int indices[] = {
+		0, 2, 1, 0, 3, 2, //back
+		4, 5, 6, 4, 6, 7, //front
+		0, 4, 7, 0, 7, 3, //left
+		1, 2, 6, 1, 6, 5, //right
+		0, 1, 5, 0, 5, 4, //bottom
+		3, 7, 6, 3, 6, 2  //top
+	};
+
+	glGenVertexArrays(1, &volumeVAO);
+	glGenBuffers(1, &volumeVBO);
+	glGenBuffers(1, &volumeEBO);
+	glBindVertexArray(volumeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
+/// <summary>
+/// Binds the G-buffer and clears it, the lit draws that follow fill it. Background pixels keep a zero normal.
+/// </summary>
+void DeferredRenderer::BeginGeometryPass(vec3 clearColour) {
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, geometryFramebuffer);
+	glViewport(0, 0, width, height);
+
+	vec4 colour = vec4(clearColour, 1.0f);
+	vec4 empty = vec4(0.0f);
+	glClearBufferfv(GL_COLOR, 0, &colour[0]);
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		glClearBufferfv(GL_COLOR, i + 1, &empty[0]);
+	}
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+/// <summary>
+/// Adds every light into the colour, one instanced draw of the range boxes.
+/// Back faces are drawn where they are behind the scene's depth, so a box shades the surfaces inside it
+/// and still works with the camera inside it. Depth clamp keeps boxes poking past the far plane.
+/// </summary>
+void DeferredRenderer::LightPass(const PointLightBuffer& lights) {
+	glBindFramebuffer(GL_FRAMEBUFFER, lightFramebuffer);
+	for (int i = 0; i < gBufferTargets; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstTextureUnit + i);
+		glBindTexture(GL_TEXTURE_2D, gBufferTextures[i]);
+	}
+
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_GEQUAL);
+	glCullFace(GL_FRONT);
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	lightShader->Use();
+	glBindVertexArray(volumeVAO);
+	glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, lights.GetLightCount());
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+	glDisable(GL_DEPTH_CLAMP);
+	glCullFace(GL_BACK);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+/// <summary>
+/// Copies the lit colour and the depth to the screen and goes back to drawing there, with the viewport it had before
+/// </summary>
+void DeferredRenderer::Resolve() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, lightFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void DeferredRenderer::CleanUp() {
+	glDeleteFramebuffers(1, &geometryFramebuffer);
+	glDeleteFramebuffers(1, &lightFramebuffer);
+	glDeleteTextures(1, &colourTexture);
+	glDeleteTextures(gBufferTargets, gBufferTextures);
+	glDeleteRenderbuffers(1, &depthRenderbuffer);
+	glDeleteVertexArrays(1, &volumeVAO);
+	glDeleteBuffers(1, &volumeVBO);
+	glDeleteBuffers(1, &volumeEBO);
+}
+
+/// <summary>
+/// Program the light volumes are shaded with, for setting its other uniforms like the lit shaders'
+/// </summary>
+Shader& DeferredRenderer::GetLightShader() {
+	return *lightShader;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "FrameUniformBuffer.h"
+#include "PointLightBuffer.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Optional deferred path for the point lights. The lit draws go into a G-buffer, where the textured and model shaders
+/// write their colour without point lights plus position, normal and reflectances. Then every light draws a box around
+/// its range with additive blending, shading only the pixels inside it from the G-buffer. The point light cost then
+/// follows the pixels each light covers rather than how much geometry, overdraw included, was drawn under it.
+/// Resolve copies the colour and depth to the screen so the unlit forward draws that follow depth test against it.
+/// </summary>
+class DeferredRenderer
+{
+public:
+	DeferredRenderer();
+	~DeferredRenderer();
+	void Create(int width, int height, int firstTextureUnit, int pointLightTextureUnit, const FrameUniformBuffer& frameUniforms);
+	void Resize(int width, int height);
+	void BeginGeometryPass(vec3 clearColour);
+	void LightPass(const PointLightBuffer& lights);
+	void Resolve();
+	void CleanUp();
+
+	Shader& GetLightShader();
+
+private:
+	//--- G-buffer attachments after the colour at attachment 0, in the order the lit shaders write them
+	static const int gBufferTargets = 5;
+
+	int width = 0;
+	int height = 0;
+	int firstTextureUnit = 0;
+	Shader* lightShader = NULL;
+
+	//Colour and every G-buffer target, written by the geometry pass
+	unsigned int geometryFramebuffer = 0;
+	//Colour alone, for the light pass to add into while it reads the G-buffer
+	unsigned int lightFramebuffer = 0;
+	unsigned int colourTexture = 0;
+	unsigned int gBufferTextures[gBufferTargets] = { 0, 0, 0, 0, 0 };
+	unsigned int depthRenderbuffer = 0;
+	//Viewport from before the geometry pass, put back by Resolve
+	int previousViewport[4] = { 0, 0, 0, 0 };
+
+	unsigned int volumeVAO = 0;
+	unsigned int volumeVBO = 0;
+	unsigned int volumeEBO = 0;
+
+	unsigned int CreateTarget();
+	void AllocateTargets();
+	void CreateVolume();
+};
@@ -0,0 +1,144 @@
+#include "DrawLightAssigner.h"
+
+#include <algorithm>
+
+const size_t initialIndexCapacity = 256;
+//Lights are few and reach far, a coarse cell keeps a query to a handful of cells
+const float lightGridCellSize = 16.0f;
+
+DrawLightAssigner::DrawLightAssigner() : lightGrid(lightGridCellSize) {
+}
+
+/// <summary>
+/// Allocates the index buffer texture and leaves it bound to indexTextureUnit. Needs a current GL context.
+/// </summary>
+void DrawLightAssigner::Create(int indexTextureUnit) {
+	this->indexTextureUnit = indexTextureUnit;
+	indexCapacity = initialIndexCapacity;
+	lightIndices.reserve(indexCapacity);
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &indexTexture);
+	glActiveTexture(GL_TEXTURE0 + indexTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+}
+
+void DrawLightAssigner::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("drawLightIndices", indexTextureUnit);
+}
+
+/// <summary>
+/// Starts a frame's lists from the lights just packed into PointLightBuffer, which has to outlive the frame's AddDraw calls
+/// </summary>
+void DrawLightAssigner::BeginFrame(const PointLightBuffer& lights) {
+	this->lights = &lights;
+	draws.clear();
+	lightIndices.clear();
+
+	const vector<PointLight>& pointLights = lights.GetLights();
+	const vector<float>& ranges = lights.GetRanges();
+
+	//A light with no attenuation has an infinite range, which no grid query can cover
+	lightPositions.clear();
+	hashedLights.clear();
+	unboundedLights.clear();
+	largestRange = 0.0f;
+	for (unsigned int light = 0; light < pointLights.size(); light++)
+	{
+		if (ranges[light] > maxHashedRange)
+		{
+			unboundedLights.push_back(light);
+			continue;
+		}
+		lightPositions.push_back(pointLights[light].position);
+		hashedLights.push_back(light);
+		largestRange = std::max(largestRange, ranges[light]);
+	}
+	lightGrid.Build(lightPositions);
+}
+
+/// <summary>
+/// Picks the lights for one draw. A light reaches the draw if its range touches the bounding sphere,
+/// and the ones kept are those brightest at the sphere's surface.
+/// </summary>
+/// <returns>Draw id to pass to Apply</returns>
+int DrawLightAssigner::AddDraw(vec3 centre, float radius) {
+	const vector<PointLight>& pointLights = lights->GetLights();
+	const vector<float>& ranges = lights->GetRanges();
+
+	//Nothing further than the largest range plus the bounds can reach, the exact test per light is below
+	lightGrid.QueryRadius(centre, radius + largestRange, candidates);
+	for (unsigned int& candidate : candidates)
+	{
+		candidate = hashedLights[candidate];
+	}
+	candidates.insert(candidates.end(), unboundedLights.begin(), unboundedLights.end());
+
+	ranked.clear();
+	for (unsigned int light : candidates)
+	{
+		const PointLight& pointLight = pointLights[light];
+		float gap = std::max(length(pointLight.position - centre) - radius, 0.0f);
+		if (gap > ranges[light])
+		{
+			continue;
+		}
+
+		vec3 brightest = max(pointLight.ambient, max(pointLight.diffuse, pointLight.specular));
+		float attenuation = 1.0f / (pointLight.constant + pointLight.linear * gap + pointLight.quadratic * gap * gap);
+		ranked.push_back({ std::max(brightest.r, std::max(brightest.g, brightest.b)) * attenuation, light });
+	}
+
+	size_t kept = std::min(ranked.size(), (size_t)maxLightsPerDraw);
+	partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end(), [](const pair<float, unsigned int>& a, const pair<float, unsigned int>& b) {
+		if (a.first != b.first)
+		{
+			return a.first > b.first;
+		}
+		return a.second < b.second;
+	});
+
+	draws.push_back(ivec2((int)lightIndices.size(), (int)kept));
+	for (size_t i = 0; i < kept; i++)
+	{
+		lightIndices.push_back(ranked[i].second);
+	}
+	return (int)draws.size() - 1;
+}
+
+/// <summary>
+/// Sends every draw's list in one call, after the frame's AddDraw calls and before the first draw. Grows by doubling.
+/// </summary>
+void DrawLightAssigner::Upload() {
+	while (indexCapacity < lightIndices.size())
+	{
+		indexCapacity *= 2;
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, lightIndices.size() * sizeof(unsigned int), lightIndices.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/// <summary>
+/// Points the shader at one draw's list through its "drawLights" uniform, the shader must be in use
+/// </summary>
+void DrawLightAssigner::Apply(const UniformHandle<ivec2>& drawLightsUniform, int draw) const {
+	drawLightsUniform.Set(draws[draw]);
+}
+
+void DrawLightAssigner::CleanUp() {
+	glDeleteTextures(1, &indexTexture);
+	glDeleteBuffers(1, &indexBuffer);
+	indexTexture = indexBuffer = 0;
+}
+
+size_t DrawLightAssigner::GetIndexCount() const {
+	return lightIndices.size();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utility>
+#include <vector>
+
+#include "PointLightBuffer.h"
+#include "Shader.h"
+#include "SpatialHashGrid.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Gives each draw its own short light list, the strongest few lights that reach its bounding sphere.
+/// The lights are put in a SpatialHashGrid once a frame, then each draw queries it with its bounds and keeps the
+/// maxLightsPerDraw lights that arrive brightest. A light reaching further than maxHashedRange, or without any range,
+/// stays out of the grid and is a candidate for every draw instead. Every draw's list goes into one index buffer texture uploaded once,
+/// and a draw only sets its offset and count before drawing.
+/// Lighter than LightClusterGrid, but a large draw is still limited to maxLightsPerDraw lights over its whole surface.
+/// </summary>
+class DrawLightAssigner
+{
+public:
+	static const int maxLightsPerDraw = 8;
+	//Past the whole scene, and keeps a query to a few cells a side
+	static constexpr float maxHashedRange = 128.0f;
+
+	DrawLightAssigner();
+	void Create(int indexTextureUnit);
+	void Attach(Shader& shader) const;
+	void BeginFrame(const PointLightBuffer& lights);
+	int AddDraw(vec3 centre, float radius);
+	void Upload();
+	void Apply(const UniformHandle<ivec2>& drawLightsUniform, int draw) const;
+	void CleanUp();
+
+	size_t GetIndexCount() const;
+
+private:
+	int indexTextureUnit = 0;
+	const PointLightBuffer* lights = NULL;
+	SpatialHashGrid lightGrid;
+	float largestRange = 0.0f;
+
+	//Per draw, x offset into lightIndices and y count
+	vector<ivec2> draws;
+	vector<unsigned int> lightIndices;
+	vector<vec3> lightPositions;
+	//Grid index -> light index
+	vector<unsigned int> hashedLights;
+	//Reach further than maxHashedRange, added to every draw's candidates
+	vector<unsigned int> unboundedLights;
+	//Scratch for AddDraw, candidates and how bright each arrives
+	vector<unsigned int> candidates;
+	vector<pair<float, unsigned int>> ranked;
+
+	unsigned int indexBuffer = 0;
+	unsigned int indexTexture = 0;
+	//In indices
+	size_t indexCapacity = 0;
+};
@@ -0,0 +1,64 @@
+#include "EventScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+/// <summary>
+/// Heap order for std::push_heap, which keeps the largest at the front, so "later" counts as less
+/// </summary>
+static bool FiresAfter(const ScheduledEvent& a, const ScheduledEvent& b) {
+	if (a.time != b.time)
+	{
+		return a.time > b.time;
+	}
+	return a.sequence > b.sequence;
+}
+
+EventScheduler::EventScheduler() {
+}
+
+void EventScheduler::Schedule(double time, int type, ProjectileHandle target) {
+	events.push_back({ time, type, target, nextSequence++ });
+	push_heap(events.begin(), events.end(), FiresAfter);
+}
+
+/// <summary>
+/// Takes the earliest event off the heap if it is due. Call in a loop until it returns false.
+/// </summary>
+/// <param name="now">Events at or before this time are due</param>
+/// <param name="event">Filled with the event when one is due</param>
+bool EventScheduler::PopDue(double now, ScheduledEvent& event) {
+	if (events.empty() || events.front().time > now)
+	{
+		return false;
+	}
+
+	pop_heap(events.begin(), events.end(), FiresAfter);
+	event = events.back();
+	events.pop_back();
+	return true;
+}
+
+/// <summary>
+/// Time of the earliest event, infinity when nothing is scheduled
+/// </summary>
+double EventScheduler::NextTime() const {
+	return events.empty() ? numeric_limits<double>::infinity() : events.front().time;
+}
+
+size_t EventScheduler::Size() const {
+	return events.size();
+}
+
+bool EventScheduler::Empty() const {
+	return events.empty();
+}
+
+void EventScheduler::Reserve(size_t capacity) {
+	events.reserve(capacity);
+}
+
+void EventScheduler::Clear() {
+	events.clear();
+	nextSequence = 0;
+}
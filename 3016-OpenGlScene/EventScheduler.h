@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ProjectileParticleStore.h"
+
+using namespace std;
+
+/// <summary>
+/// One timed event. What type means is up to the owner of the scheduler, target says which object it is for.
+/// </summary>
+struct ScheduledEvent
+{
+	double time;
+	int type;
+	//Object the event belongs to, compared against the live handle when it fires so events for removed objects are skipped
+	ProjectileHandle target;
+	//Order of scheduling, events due at the same time come out in the order they went in
+	uint64_t sequence;
+};
+
+/// <summary>
+/// Min heap of timed events (spawns, lifetimes running out, flicker keyframes, sound stops).
+/// Events are scheduled once when their time becomes known, and each update only pops the ones now due, so the cost of
+/// a frame follows how many events fire rather than how many objects are alive.
+/// There is no cancel, an owner that removes an object early just ignores its stale events when they come due.
+/// </summary>
+class EventScheduler
+{
+public:
+	EventScheduler();
+	void Schedule(double time, int type, ProjectileHandle target = { 0, 0 });
+	bool PopDue(double now, ScheduledEvent& event);
+	double NextTime() const;
+	size_t Size() const;
+	bool Empty() const;
+	void Reserve(size_t capacity);
+	void Clear();
+
+private:
+	vector<ScheduledEvent> events;
+	uint64_t nextSequence = 0;
+};
@@ -0,0 +1,43 @@
+#include "FrameUniformBuffer.h"
+
+FrameUniformBuffer::FrameUniformBuffer() {
+}
+
+/// <summary>
+/// Allocates the buffer and binds it to bindingPoint, where it stays for the rest of the run. Needs a current GL context.
+/// </summary>
+void FrameUniformBuffer::Create() {
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+}
+
+/// <summary>
+/// Points a program's FrameUniforms block at bindingPoint. Programs without the block are left alone.
+/// </summary>
+void FrameUniformBuffer::Attach(const Shader& shader) const {
+	unsigned int blockIndex = glGetUniformBlockIndex(shader.ID, "FrameUniforms");
+	if (blockIndex != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(shader.ID, blockIndex, bindingPoint);
+	}
+}
+
+/// <summary>
+/// Sends the whole of data in one call, once a frame before the first draw
+/// </summary>
+void FrameUniformBuffer::Upload() {
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniformBuffer::CleanUp() {
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
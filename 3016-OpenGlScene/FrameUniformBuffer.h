@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// CPU side of the FrameUniforms block, laid out by std140 rules. A vec3 takes a 16 byte slot,
+/// so each is followed by the scalar that shares its slot in the shaders or by explicit padding.
+/// </summary>
+struct FrameUniformData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+
+	//--- Directional light, ambient is per program
+	vec3 dirLightDirection;
+	//Lights in PointLightBuffer this frame
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	float padding1;
+	vec3 dirLightSpecular;
+	float padding2;
+
+	//--- Camera spot light, ambient is per program
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+	float padding3[3];
+};
+
+static_assert(sizeof(FrameUniformData) == 272, "FrameUniformData must match the std140 FrameUniforms block");
+
+/// <summary>
+/// Uniform buffer holding the camera, time and global lights shared by every scene program.
+/// It sits on one fixed binding point, so a frame's constants are written once with a single upload
+/// rather than set again on each program, and switching programs doesn't need them set again.
+/// </summary>
+class FrameUniformBuffer
+{
+public:
+	static const unsigned int bindingPoint = 0;
+
+	FrameUniformBuffer();
+	void Create();
+	void Attach(const Shader& shader) const;
+	void Upload();
+	void CleanUp();
+
+	//Filled in each frame then sent by Upload
+	FrameUniformData data = {};
+
+private:
+	unsigned int buffer = 0;
+};
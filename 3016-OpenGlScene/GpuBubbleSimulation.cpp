@@ -0,0 +1,208 @@
+#include "GpuBubbleSimulation.h"
+
+#include <string>
+
+#include "BubbleSimulation.h"
+
+//Frames slower than this many steps drop the rest rather than stalling the GPU with catch up passes
+const int maxStepsPerUpdate = 4;
+
+GpuBubbleSimulation::GpuBubbleSimulation() {
+}
+
+GpuBubbleSimulation::~GpuBubbleSimulation() {
+	delete updateShader;
+}
+
+/// <summary>
+/// Builds the update program, both record buffers and the launch buffer. Needs a current GL context.
+/// Launches come from the same mapping the CPU simulation uses, so both modes throw bubbles the same way.
+/// Bubbles start out waiting a spread out share of their first cooldown, so they don't all appear on the first frame.
+/// </summary>
+/// <param name="bubbleCount">Bubbles alive at once, fixed for the life of the buffers</param>
+/// <param name="launchCount">Pre made launches, each bubble walks through them bubbleCount apart</param>
+/// <param name="launchRandom">Stream the launch values are drawn from</param>
+/// <param name="launchTextureUnit">Texture unit the launch buffer is bound to for the update pass</param>
+void GpuBubbleSimulation::Create(size_t bubbleCount, size_t launchCount, PhiloxRandom& launchRandom, int launchTextureUnit) {
+	this->bubbleCount = bubbleCount;
+	this->launchCount = launchCount;
+	this->launchTextureUnit = launchTextureUnit;
+
+	vector<string> feedbackVaryings = { "outRenderData", "outLaunchPosition", "outLaunchVelocity", "outLife" };
+	updateShader = new Shader("Shaders/BubbleUpdateVertexShader.v", feedbackVaryings);
+
+	// ---------------------------
+	// Launch buffer
+	// ---------------------------
+	vector<vec4> launchTexels(launchCount * 3);
+	vector<float> launchRandoms(launchCount * BubbleSimulation::launchRandomCount);
+	launchRandom.FillFloats(launchRandoms.data(), launchRandoms.size());
+	for (size_t i = 0; i < launchCount; i++)
+	{
+		BubbleLaunch launch = BubbleSimulation::CreateLaunch(&launchRandoms[i * BubbleSimulation::launchRandomCount]);
+
+		//Golden ratio spacing, same as the phase the CPU path gives each slot
+		float phase = fract(i * 0.618034f);
+
+		launchTexels[i * 3] = vec4(launch.position, launch.gravityMultiplier);
+		launchTexels[i * 3 + 1] = vec4(launch.velocity, launch.movespeedMultiplier);
+		launchTexels[i * 3 + 2] = vec4(launch.cooldown, phase, 0.0f, 0.0f);
+	}
+
+	glGenBuffers(1, &launchBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, launchBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, launchTexels.size() * sizeof(vec4), launchTexels.data(), GL_STATIC_DRAW);
+
+	glGenTextures(1, &launchTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, launchTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, launchBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// ---------------------------
+	// Starting records
+	// ---------------------------
+	//Bubble i begins on launch i
+	vector<float> records(bubbleCount * recordFloats);
+	for (size_t i = 0; i < bubbleCount; i++)
+	{
+		size_t launchIndex = i % launchCount;
+		vec4 position = launchTexels[launchIndex * 3];
+		vec4 velocity = launchTexels[launchIndex * 3 + 1];
+		vec4 timing = launchTexels[launchIndex * 3 + 2];
+		float startDelay = timing.x * fract(i * 0.618034f);
+
+		float* record = &records[i * recordFloats];
+		vec4 renderData = vec4(vec3(position), -1.0f);
+		vec4 life = vec4(-startDelay, lifetime, 0.0f, timing.y);
+		for (int c = 0; c < 4; c++)
+		{
+			record[c] = renderData[c];
+			record[4 + c] = position[c];
+			record[8 + c] = velocity[c];
+			record[12 + c] = life[c];
+		}
+	}
+
+	// ---------------------------
+	// Ping pong buffers
+	// ---------------------------
+	//One VAO per buffer for reading it in the update pass, the draw reads the same buffer as instance data
+	glGenBuffers(2, particleBuffers);
+	glGenVertexArrays(2, updateVAOs);
+	for (int b = 0; b < 2; b++)
+	{
+		glBindVertexArray(updateVAOs[b]);
+		glBindBuffer(GL_ARRAY_BUFFER, particleBuffers[b]);
+		glBufferData(GL_ARRAY_BUFFER, records.size() * sizeof(float), records.data(), GL_DYNAMIC_COPY);
+
+		for (unsigned int attribute = 0; attribute < 4; attribute++)
+		{
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, recordStride, (void*)(attribute * sizeof(vec4)));
+		}
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	updateShader->Use();
+	updateShader->setInt("launches", launchTextureUnit);
+	updateShader->setInt("launchCount", (int)launchCount);
+	updateShader->setInt("bubbleCount", (int)bubbleCount);
+
+	current = 0;
+	accumulator = 0.0f;
+}
+
+/// <summary>
+/// Drifts the bubbles on the wind's texture, which must already be bound to windTextureUnit
+/// </summary>
+void GpuBubbleSimulation::SetWindField(const WindField& windField, int windTextureUnit) {
+	updateShader->Use();
+	updateShader->setBool("useWind", true);
+	updateShader->setInt("windField", windTextureUnit);
+	updateShader->setVec3("windOrigin", windField.GetOrigin());
+	updateShader->setVec3("windExtent", windField.GetExtent());
+}
+
+/// <summary>
+/// Runs however many fixed steps this frame's time covers
+/// </summary>
+void GpuBubbleSimulation::Update(float deltaTime) {
+	accumulator += deltaTime;
+
+	int steps = 0;
+	while (accumulator >= stepTime && steps < maxStepsPerUpdate)
+	{
+		Step(stepTime);
+		accumulator -= stepTime;
+		steps++;
+	}
+
+	if (steps == maxStepsPerUpdate)
+	{
+		accumulator = 0.0f;
+	}
+}
+
+/// <summary>
+/// One update pass. Rasterising is switched off, the vertex program's outputs go straight into the other buffer.
+/// </summary>
+void GpuBubbleSimulation::Step(float stepTime) {
+	int next = 1 - current;
+
+	updateShader->Use();
+	updateShader->setFloat("deltaTime", stepTime);
+	updateShader->setFloat("gravity", gravity);
+	updateShader->setFloat("lifetime", lifetime);
+
+	glActiveTexture(GL_TEXTURE0 + launchTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, launchTexture);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(updateVAOs[current]);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, particleBuffers[next]);
+
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)bubbleCount);
+	glEndTransformFeedback();
+
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	current = next;
+}
+
+/// <summary>
+/// Buffer with the latest records, bind it as instance data with recordStride and the render data at offset 0
+/// </summary>
+unsigned int GpuBubbleSimulation::GetRenderBuffer() const {
+	return particleBuffers[current];
+}
+
+size_t GpuBubbleSimulation::GetBubbleCount() const {
+	return bubbleCount;
+}
+
+/// <summary>
+/// Copies the latest records back to the CPU. Stalls until the GPU has caught up, for checking and benchmarks only.
+/// </summary>
+vector<float> GpuBubbleSimulation::ReadBack() const {
+	vector<float> records(bubbleCount * recordFloats);
+	glBindBuffer(GL_ARRAY_BUFFER, particleBuffers[current]);
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, records.size() * sizeof(float), records.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return records;
+}
+
+void GpuBubbleSimulation::CleanUp() {
+	glDeleteVertexArrays(2, updateVAOs);
+	glDeleteBuffers(2, particleBuffers);
+	glDeleteBuffers(1, &launchBuffer);
+	glDeleteTextures(1, &launchTexture);
+	if (updateShader != NULL)
+	{
+		glDeleteProgram(updateShader->ID);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "PhiloxRandom.h"
+#include "Shader.h"
+#include "WindField.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Bubble simulation that stays on the GPU. Each bubble is one record in a vertex buffer, a transform feedback pass
+/// reads the records from one buffer and writes the advanced records into the other, then the two swap.
+/// Bubbles that pop or expire are relaunched inside the same pass from a buffer of pre made launches,
+/// so the CPU only issues the update pass and the draws, it never reads or writes a bubble.
+/// Everything used is core in OpenGL 3.3.
+/// </summary>
+class GpuBubbleSimulation
+{
+public:
+	//--- Record layout, four vec4s per bubble
+	//renderData: xyz position, w phase, negative while the bubble waits to launch, so it reads as the draw's instanceData
+	//launchPosition: xyz, w gravity multiplier
+	//launchVelocity: xyz, w movespeed multiplier
+	//life: x age (negative while waiting), y lifetime, z launches so far, w phase
+	static const int recordFloats = 16;
+	static const GLsizei recordStride = recordFloats * sizeof(float);
+
+	GpuBubbleSimulation();
+	~GpuBubbleSimulation();
+	void Create(size_t bubbleCount, size_t launchCount, PhiloxRandom& launchRandom, int launchTextureUnit);
+	void SetWindField(const WindField& windField, int windTextureUnit);
+	void Update(float deltaTime);
+	void Step(float stepTime);
+	void CleanUp();
+
+	unsigned int GetRenderBuffer() const;
+	size_t GetBubbleCount() const;
+	vector<float> ReadBack() const;
+
+	float gravity = 9.81f;
+	float lifetime = 20.0f;
+	//Fixed step, Update runs as many as the frame time covers
+	float stepTime = 1.0f / 60.0f;
+
+private:
+	Shader* updateShader = NULL;
+	unsigned int particleBuffers[2] = { 0, 0 };
+	unsigned int updateVAOs[2] = { 0, 0 };
+	unsigned int launchBuffer = 0;
+	unsigned int launchTexture = 0;
+	int launchTextureUnit = 0;
+	//Buffer holding the latest records, the other one is written by the next Step
+	int current = 0;
+
+	size_t bubbleCount = 0;
+	size_t launchCount = 0;
+	float accumulator = 0.0f;
+};
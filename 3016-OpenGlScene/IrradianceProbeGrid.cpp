@@ -0,0 +1,381 @@
+#include "IrradianceProbeGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PointLightBuffer.h"
+
+//--- Real spherical harmonic basis up to band 2, the same constants as the shaders' ProbeBasis
+const float shBand0 = 0.282095f;
+const float shBand1 = 0.488603f;
+const float shBand2 = 1.092548f;
+const float shBand2Zonal = 0.315392f;
+const float shBand2Sectoral = 0.546274f;
+//Cosine lobe convolution per band, pi, 2pi/3 and pi/4, so evaluating gives irradiance rather than radiance
+const float cosineLobe[3] = { 3.141593f, 2.094395f, 0.785398f };
+
+void ProbeBasis(vec3 direction, float basis[IrradianceProbeGrid::coefficientCount]) {
+	basis[0] = shBand0;
+	basis[1] = shBand1 * direction.y;
+	basis[2] = shBand1 * direction.z;
+	basis[3] = shBand1 * direction.x;
+	basis[4] = shBand2 * direction.x * direction.y;
+	basis[5] = shBand2 * direction.y * direction.z;
+	basis[6] = shBand2Zonal * (3.0f * direction.z * direction.z - 1.0f);
+	basis[7] = shBand2 * direction.x * direction.z;
+	basis[8] = shBand2Sectoral * (direction.x * direction.x - direction.y * direction.y);
+}
+
+IrradianceProbeGrid::IrradianceProbeGrid() {
+}
+
+IrradianceProbeGrid::~IrradianceProbeGrid() {
+	Stop();
+}
+
+/// <summary>
+/// Allocates the probes, all dark, and their 3D texture left bound to textureUnit. Needs a current GL context.
+/// </summary>
+/// <param name="maxLights">Slots, SetLight takes 0 up to this</param>
+void IrradianceProbeGrid::Create(int maxLights, ivec3 resolution, vec3 origin, vec3 extent, int textureUnit) {
+	this->resolution = resolution;
+	this->origin = origin;
+	this->extent = extent;
+	this->textureUnit = textureUnit;
+	cellSize = extent / vec3(resolution);
+
+	ProbeLight emptySlot = {};
+	slots.assign(maxLights, emptySlot);
+	size_t probeCount = (size_t)resolution.x * resolution.y * resolution.z;
+	texels.assign(probeCount * slabCount, vec4(0.0f));
+	dirty.assign(probeCount, 0);
+
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_3D, texture);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, resolution.x, resolution.y, resolution.z * slabCount, 0, GL_RGBA, GL_FLOAT, texels.data());
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+void IrradianceProbeGrid::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("irradianceProbes", textureUnit);
+	shader.setVec3("irradianceProbeOrigin", origin);
+	shader.setVec3("irradianceProbeExtent", extent);
+	shader.setIVec3("irradianceProbeResolution", resolution);
+}
+
+/// <summary>
+/// Starts the worker threads. Without any, BeginUpdate projects the probes itself before returning.
+/// </summary>
+void IrradianceProbeGrid::Start(int workerCount) {
+	Stop();
+	stopping = false;
+	for (int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(thread(&IrradianceProbeGrid::WorkerLoop, this, i));
+	}
+}
+
+void IrradianceProbeGrid::Stop() {
+	EndUpdate();
+	{
+		lock_guard<mutex> lock(workMutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+	for (thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+/// <summary>
+/// Puts a light in a slot, or keeps it there, for every update it should stay in the grid. Only its position, attenuation,
+/// diffuse and ambient colours are used. The probes around it are only projected again once it moves moveThreshold
+/// cells or changes colour, until then they keep where it was.
+/// </summary>
+void IrradianceProbeGrid::SetLight(int slot, const PointLight& light) {
+	ProbeLight& probeLight = slots[slot];
+	float range = PointLightBuffer::LightRange(light);
+	float threshold = moveThreshold * std::min(cellSize.x, std::min(cellSize.y, cellSize.z));
+
+	bool changed = !probeLight.active || probeLight.diffuse != light.diffuse || probeLight.ambient != light.ambient
+		|| probeLight.constant != light.constant || probeLight.linear != light.linear || probeLight.quadratic != light.quadratic
+		|| length(light.position - probeLight.position) > threshold;
+	if (changed)
+	{
+		if (probeLight.active)
+		{
+			MarkDirty(probeLight.position, probeLight.range);
+		}
+		probeLight.position = light.position;
+		probeLight.diffuse = light.diffuse;
+		probeLight.ambient = light.ambient;
+		probeLight.constant = light.constant;
+		probeLight.linear = light.linear;
+		probeLight.quadratic = light.quadratic;
+		probeLight.range = range;
+		probeLight.active = true;
+		MarkDirty(probeLight.position, probeLight.range);
+	}
+	probeLight.seen = true;
+}
+
+/// <summary>
+/// Drops the slots that weren't set since the last update and starts projecting every probe that needs it.
+/// The texture isn't touched until EndUpdate, so this can go out early in a frame and be collected late, or the next frame.
+/// </summary>
+void IrradianceProbeGrid::BeginUpdate() {
+	EndUpdate();
+
+	for (ProbeLight& probeLight : slots)
+	{
+		if (probeLight.active && !probeLight.seen)
+		{
+			probeLight.active = false;
+			MarkDirty(probeLight.position, probeLight.range);
+		}
+		probeLight.seen = false;
+	}
+
+	updateProbes.clear();
+	for (int probe = 0; probe < (int)dirty.size(); probe++)
+	{
+		if (dirty[probe])
+		{
+			updateProbes.push_back(probe);
+			dirty[probe] = 0;
+		}
+	}
+	probesUpdated = (int)updateProbes.size();
+	if (updateProbes.empty())
+	{
+		return;
+	}
+
+	updateLights.clear();
+	for (const ProbeLight& probeLight : slots)
+	{
+		if (probeLight.active)
+		{
+			updateLights.push_back(probeLight);
+		}
+	}
+
+	updating = true;
+	if (workers.empty())
+	{
+		ProjectProbes(0, 1);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(workMutex);
+		workersBusy = (int)workers.size();
+		generation++;
+	}
+	workReady.notify_all();
+}
+
+/// <summary>
+/// Waits for the workers and uploads the slices holding the probes they projected. Does nothing without an update going.
+/// </summary>
+void IrradianceProbeGrid::EndUpdate() {
+	if (!updating)
+	{
+		return;
+	}
+
+	{
+		unique_lock<mutex> lock(workMutex);
+		workDone.wait(lock, [this] { return workersBusy == 0; });
+	}
+	updating = false;
+
+	//Probes are listed in order, so the first and last give the z slices they span
+	int sliceSize = resolution.x * resolution.y;
+	int firstZ = updateProbes.front() / sliceSize;
+	int lastZ = updateProbes.back() / sliceSize;
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_3D, texture);
+	for (int slab = 0; slab < slabCount; slab++)
+	{
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slab * resolution.z + firstZ, resolution.x, resolution.y, lastZ - firstZ + 1,
+			GL_RGBA, GL_FLOAT, &texels[TexelIndex(slab, 0, 0, firstZ)]);
+	}
+}
+
+/// <summary>
+/// Irradiance and ambient at a point, from the probes as last projected. The same lookup as the shaders' CalcProbeLight,
+/// trilinear between the eight nearest probes and held at the outermost ones past the edge of the grid.
+/// </summary>
+void IrradianceProbeGrid::Sample(vec3 position, vec3 normal, vec3& diffuse, vec3& ambient) const {
+	vec3 cell = glm::clamp((position - origin) / cellSize - 0.5f, vec3(0.0f), vec3(resolution - 1));
+	ivec3 low = ivec3(floor(cell));
+	ivec3 high = min(low + 1, resolution - 1);
+	vec3 weight = cell - vec3(low);
+
+	vec4 slabs[slabCount];
+	for (int slab = 0; slab < slabCount; slab++)
+	{
+		vec4 x00 = mix(texels[TexelIndex(slab, low.x, low.y, low.z)], texels[TexelIndex(slab, high.x, low.y, low.z)], weight.x);
+		vec4 x10 = mix(texels[TexelIndex(slab, low.x, high.y, low.z)], texels[TexelIndex(slab, high.x, high.y, low.z)], weight.x);
+		vec4 x01 = mix(texels[TexelIndex(slab, low.x, low.y, high.z)], texels[TexelIndex(slab, high.x, low.y, high.z)], weight.x);
+		vec4 x11 = mix(texels[TexelIndex(slab, low.x, high.y, high.z)], texels[TexelIndex(slab, high.x, high.y, high.z)], weight.x);
+		slabs[slab] = mix(mix(x00, x10, weight.y), mix(x01, x11, weight.y), weight.z);
+	}
+
+	float basis[coefficientCount];
+	ProbeBasis(normal, basis);
+	vec4 basisLow = vec4(basis[0], basis[1], basis[2], basis[3]);
+	vec4 basisHigh = vec4(basis[4], basis[5], basis[6], basis[7]);
+	diffuse = vec3(
+		dot(slabs[0], basisLow) + dot(slabs[1], basisHigh) + slabs[6].r * basis[8],
+		dot(slabs[2], basisLow) + dot(slabs[3], basisHigh) + slabs[6].g * basis[8],
+		dot(slabs[4], basisLow) + dot(slabs[5], basisHigh) + slabs[6].b * basis[8]);
+	//Two bands don't hold a point light's sharp edge, it rings a little negative behind the light
+	diffuse = max(diffuse, vec3(0.0f));
+	ambient = vec3(slabs[7]);
+}
+
+void IrradianceProbeGrid::CleanUp() {
+	Stop();
+	glDeleteTextures(1, &texture);
+	texture = 0;
+}
+
+/// <summary>
+/// Probes the last update projected
+/// </summary>
+int IrradianceProbeGrid::GetProbesUpdated() const {
+	return probesUpdated;
+}
+
+/// <summary>
+/// Marks every probe a light reaches, the probes whose centres are inside its range
+/// </summary>
+void IrradianceProbeGrid::MarkDirty(vec3 centre, float radius) {
+	ivec3 low = max(ivec3(ceil((centre - radius - origin) / cellSize - 0.5f)), ivec3(0));
+	ivec3 high = min(ivec3(floor((centre + radius - origin) / cellSize - 0.5f)), resolution - 1);
+	for (int z = low.z; z <= high.z; z++)
+	{
+		for (int y = low.y; y <= high.y; y++)
+		{
+			for (int x = low.x; x <= high.x; x++)
+			{
+				int probe = (z * resolution.y + y) * resolution.x + x;
+				if (length(ProbeCentre(probe) - centre) < radius)
+				{
+					dirty[probe] = 1;
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Each worker takes every workerCount-th probe, neighbours cost about the same so the split comes out even
+/// </summary>
+void IrradianceProbeGrid::ProjectProbes(int worker, int workerCount) {
+	for (size_t i = worker; i < updateProbes.size(); i += workerCount)
+	{
+		ProjectProbe(updateProbes[i]);
+	}
+}
+
+/// <summary>
+/// Projects every light in range into one probe from scratch. Each light is taken as arriving from a single direction,
+/// CalcPointLight's attenuation and range fade scaling its colour.
+/// </summary>
+void IrradianceProbeGrid::ProjectProbe(int probe) {
+	vec3 centre = ProbeCentre(probe);
+	vec3 coefficients[coefficientCount];
+	for (vec3& coefficient : coefficients)
+	{
+		coefficient = vec3(0.0f);
+	}
+	vec3 ambient = vec3(0.0f);
+
+	for (const ProbeLight& light : updateLights)
+	{
+		vec3 toLight = light.position - centre;
+		float distance = length(toLight);
+		if (distance >= light.range)
+		{
+			continue;
+		}
+
+		float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		//Same fade to nothing at the range as the shaders
+		float fade = glm::clamp(1.0f - powf(distance / std::max(light.range, 0.0001f), 4.0f), 0.0f, 1.0f);
+		attenuation *= fade * fade;
+		ambient += light.ambient * attenuation;
+
+		//A light right on the probe lights every direction equally
+		if (distance <= 0.0f)
+		{
+			coefficients[0] += light.diffuse * attenuation * cosineLobe[0] * shBand0;
+			continue;
+		}
+		float basis[coefficientCount];
+		ProbeBasis(toLight / distance, basis);
+		for (int i = 0; i < coefficientCount; i++)
+		{
+			int band = i == 0 ? 0 : (i < 4 ? 1 : 2);
+			coefficients[i] += light.diffuse * attenuation * cosineLobe[band] * basis[i];
+		}
+	}
+
+	int x = probe % resolution.x;
+	int y = (probe / resolution.x) % resolution.y;
+	int z = probe / (resolution.x * resolution.y);
+	for (int channel = 0; channel < 3; channel++)
+	{
+		texels[TexelIndex(channel * 2, x, y, z)] = vec4(coefficients[0][channel], coefficients[1][channel], coefficients[2][channel], coefficients[3][channel]);
+		texels[TexelIndex(channel * 2 + 1, x, y, z)] = vec4(coefficients[4][channel], coefficients[5][channel], coefficients[6][channel], coefficients[7][channel]);
+	}
+	texels[TexelIndex(6, x, y, z)] = vec4(coefficients[8], 0.0f);
+	texels[TexelIndex(7, x, y, z)] = vec4(ambient, 0.0f);
+}
+
+/// <summary>
+/// Sleeps until BeginUpdate hands out an update, projects its share then reports back
+/// </summary>
+void IrradianceProbeGrid::WorkerLoop(int worker) {
+	uint64_t seenGeneration = 0;
+	unique_lock<mutex> lock(workMutex);
+	while (true)
+	{
+		workReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+		if (stopping)
+		{
+			return;
+		}
+		seenGeneration = generation;
+
+		lock.unlock();
+		ProjectProbes(worker, (int)workers.size());
+		lock.lock();
+
+		workersBusy--;
+		if (workersBusy == 0)
+		{
+			workDone.notify_all();
+		}
+	}
+}
+
+vec3 IrradianceProbeGrid::ProbeCentre(int probe) const {
+	ivec3 cell = ivec3(probe % resolution.x, (probe / resolution.x) % resolution.y, probe / (resolution.x * resolution.y));
+	return origin + (vec3(cell) + 0.5f) * cellSize;
+}
+
+size_t IrradianceProbeGrid::TexelIndex(int slab, int x, int y, int z) const {
+	return (((size_t)slab * resolution.z + z) * resolution.y + y) * resolution.x + x;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PointLight.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Ambient and soft diffuse light from many lights, projected into a grid of probes so a fragment reads it with
+/// one trilinear lookup rather than looping over them. Each probe holds the lights' irradiance as L2 spherical harmonics,
+/// nine coefficients a colour channel, already convolved with the cosine lobe so the shaders evaluate it at the normal
+/// and get CalcPointLight's N dot L term summed over the lights. The lights' ambient terms are summed alongside.
+/// Lights are kept in slots. Only the probes within range of a light that was added, removed or moved far enough
+/// are projected again, on worker threads between BeginUpdate and EndUpdate. The grid is low frequency, a light
+/// close to a surface is better off as a point light.
+/// Probes sit at cell centres over the grid. Sample matches the shaders' lookup.
+/// </summary>
+class IrradianceProbeGrid
+{
+public:
+	static const int coefficientCount = 9;
+	//--- RGBA texels per probe, each stacked as its own block of slices along the texture's z
+	//0-1: red coefficients 0-3 and 4-7, 2-3: green, 4-5: blue
+	//6: coefficient 8 of red, green and blue
+	//7: summed ambient
+	static const int slabCount = 8;
+
+	IrradianceProbeGrid();
+	~IrradianceProbeGrid();
+	void Create(int maxLights, ivec3 resolution, vec3 origin, vec3 extent, int textureUnit);
+	void Attach(Shader& shader) const;
+
+	void Start(int workerCount);
+	void Stop();
+
+	void SetLight(int slot, const PointLight& light);
+	void BeginUpdate();
+	void EndUpdate();
+
+	void Sample(vec3 position, vec3 normal, vec3& diffuse, vec3& ambient) const;
+	void CleanUp();
+
+	int GetProbesUpdated() const;
+
+	//A light is projected again once it has moved this far, in cells
+	float moveThreshold = 0.25f;
+
+private:
+	struct ProbeLight
+	{
+		vec3 position;
+		vec3 diffuse;
+		vec3 ambient;
+		float constant;
+		float linear;
+		float quadratic;
+		float range;
+		bool active;
+		//Set since the last BeginUpdate, a slot that wasn't has gone
+		bool seen;
+	};
+	vector<ProbeLight> slots;
+
+	ivec3 resolution = ivec3(0);
+	vec3 origin = vec3(0.0f);
+	vec3 extent = vec3(0.0f);
+	vec3 cellSize = vec3(1.0f);
+	int textureUnit = 0;
+	unsigned int texture = 0;
+
+	//Texture layout, x fastest then y then z then slab
+	vector<vec4> texels;
+	//Per probe, x fastest then y then z
+	vector<char> dirty;
+
+	//--- Handed to the workers by BeginUpdate, read only until EndUpdate
+	vector<ProbeLight> updateLights;
+	vector<int> updateProbes;
+	int probesUpdated = 0;
+
+	vector<thread> workers;
+	mutex workMutex;
+	condition_variable workReady;
+	condition_variable workDone;
+	//Bumped for each update so a worker knows there's a new one
+	uint64_t generation = 0;
+	int workersBusy = 0;
+	bool stopping = false;
+	bool updating = false;
+
+	void MarkDirty(vec3 centre, float radius);
+	void ProjectProbes(int worker, int workerCount);
+	void ProjectProbe(int probe);
+	void WorkerLoop(int worker);
+
+	vec3 ProbeCentre(int probe) const;
+	size_t TexelIndex(int slab, int x, int y, int z) const;
+};
@@ -0,0 +1,96 @@
+#include "LightAnimationSet.h"
+
+#include <algorithm>
+#include <cmath>
+
+LightAnimationSet::LightAnimationSet() {
+}
+
+/// <summary>
+/// Sets the samples in every curve and ramp, before any are added
+/// </summary>
+void LightAnimationSet::Create(int curveLength, int rampLength) {
+	this->curveLength = curveLength;
+	this->rampLength = std::max(rampLength, 2);
+	curves.clear();
+	ramps.clear();
+}
+
+/// <summary>
+/// Adds a curve of curveLength positions along a ramp, 0 its first colour and 1 its last. It plays in a loop,
+/// the last position blends back into the first.
+/// </summary>
+/// <returns>Curve for LightAnimation</returns>
+int LightAnimationSet::AddCurve(const float* positions) {
+	curves.insert(curves.end(), positions, positions + curveLength);
+	return (int)(curves.size() / curveLength) - 1;
+}
+
+/// <summary>
+/// Adds a ramp through evenly spaced colours, blended linearly between them
+/// </summary>
+/// <returns>Ramp for LightAnimation</returns>
+int LightAnimationSet::AddRamp(const vec3* stops, int stopCount) {
+	for (int i = 0; i < rampLength; i++)
+	{
+		float stop = (float)i / (rampLength - 1) * (stopCount - 1);
+		int low = std::min((int)stop, stopCount - 1);
+		int high = std::min(low + 1, stopCount - 1);
+		ramps.push_back(vec4(mix(stops[low], stops[high], stop - low), 1.0f));
+	}
+	return (int)(ramps.size() / rampLength) - 1;
+}
+
+/// <summary>
+/// Sends both tables to the GPU, each left bound to its unit. Needs a current GL context.
+/// </summary>
+void LightAnimationSet::Upload(int curveTextureUnit, int rampTextureUnit) {
+	this->curveTextureUnit = curveTextureUnit;
+	this->rampTextureUnit = rampTextureUnit;
+	int curveCount = std::max((int)(curves.size() / std::max(curveLength, 1)), 1);
+	int rampCount = std::max((int)(ramps.size() / rampLength), 1);
+	curves.resize((size_t)curveCount * curveLength, 0.0f);
+	ramps.resize((size_t)rampCount * rampLength, vec4(1.0f));
+
+	glGenTextures(1, &curveTexture);
+	glActiveTexture(GL_TEXTURE0 + curveTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, curveTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, curveLength, curveCount, 0, GL_RED, GL_FLOAT, curves.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenTextures(1, &rampTexture);
+	glActiveTexture(GL_TEXTURE0 + rampTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, rampTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, rampLength, rampCount, 0, GL_RGBA, GL_FLOAT, ramps.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void LightAnimationSet::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("lightAnimationCurves", curveTextureUnit);
+	shader.setInt("lightAnimationRamps", rampTextureUnit);
+}
+
+void LightAnimationSet::CleanUp() {
+	glDeleteTextures(1, &curveTexture);
+	glDeleteTextures(1, &rampTexture);
+	curveTexture = rampTexture = 0;
+}
+
+/// <summary>
+/// Brightest each channel of a ramp gets, what an animated light is taken as wherever its colour has to be known ahead of time
+/// </summary>
+vec3 LightAnimationSet::BrightestColour(int ramp) const {
+	vec3 brightest = vec3(0.0f);
+	for (int i = 0; i < rampLength; i++)
+	{
+		brightest = max(brightest, vec3(ramps[(size_t)ramp * rampLength + i]));
+	}
+	return brightest;
+}
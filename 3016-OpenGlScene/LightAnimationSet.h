@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "PointLight.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Light flicker the shaders play back from FrameUniforms' time, so an animated light costs the CPU nothing each frame.
+/// A curve is a loop of positions along a ramp, a ramp is a row of colours. A light's LightAnimation picks a curve,
+/// a ramp, how fast the curve plays and where it starts, and the shaders scale its diffuse and specular by the ramp's
+/// colour at that point. Both tables are uploaded once after everything is added, one texture row each.
+/// </summary>
+class LightAnimationSet
+{
+public:
+	LightAnimationSet();
+	void Create(int curveLength, int rampLength);
+	int AddCurve(const float* positions);
+	int AddRamp(const vec3* stops, int stopCount);
+
+	void Upload(int curveTextureUnit, int rampTextureUnit);
+	void Attach(Shader& shader) const;
+	void CleanUp();
+
+	vec3 BrightestColour(int ramp) const;
+
+private:
+	int curveLength = 0;
+	int rampLength = 0;
+	//A row per curve, ramp positions 0 to 1
+	vector<float> curves;
+	//A row per ramp
+	vector<vec4> ramps;
+
+	int curveTextureUnit = 0;
+	int rampTextureUnit = 0;
+	unsigned int curveTexture = 0;
+	unsigned int rampTexture = 0;
+};
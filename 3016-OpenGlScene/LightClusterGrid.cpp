@@ -0,0 +1,204 @@
+#include "LightClusterGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+const size_t initialIndexCapacity = 1024;
+
+LightClusterGrid::LightClusterGrid() {
+}
+
+/// <summary>
+/// Allocates both buffer textures and leaves them bound to their units. Needs a current GL context.
+/// </summary>
+/// <param name="screenSize">Framebuffer size in pixels the tiles divide</param>
+/// <param name="nearPlane">Same near and far as the projection, slices are spaced between them</param>
+void LightClusterGrid::Create(int clusterTextureUnit, int indexTextureUnit, vec2 screenSize, float nearPlane, float farPlane) {
+	this->clusterTextureUnit = clusterTextureUnit;
+	this->indexTextureUnit = indexTextureUnit;
+	this->screenSize = screenSize;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+
+	clusters.assign(clusterCount, uvec2(0));
+	indexCapacity = initialIndexCapacity;
+	lightIndices.reserve(indexCapacity);
+
+	glGenBuffers(1, &clusterBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, clusterCount * sizeof(uvec2), clusters.data(), GL_STREAM_DRAW);
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &clusterTexture);
+	glActiveTexture(GL_TEXTURE0 + clusterTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, clusterTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, clusterBuffer);
+
+	glGenTextures(1, &indexTexture);
+	glActiveTexture(GL_TEXTURE0 + indexTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+}
+
+/// <summary>
+/// Sets the grid layout and texture units on a lit program. Only the screen size changes after Create
+/// </summary>
+void LightClusterGrid::Attach(Shader& shader) const {
+	float depthScale = slices / log(farPlane / nearPlane);
+
+	shader.Use();
+	shader.setInt("lightClusters", clusterTextureUnit);
+	shader.setInt("lightClusterIndices", indexTextureUnit);
+	shader.setIVec3("clusterDimensions", ivec3(tilesX, tilesY, slices));
+	shader.setVec2("clusterScreenSize", screenSize);
+	shader.setFloat("clusterDepthScale", depthScale);
+	shader.setFloat("clusterDepthBias", -log(nearPlane) * depthScale);
+}
+
+/// <summary>
+/// For a resized framebuffer, the fragments find their tile by dividing their pixel position by this.
+/// Attach every program again after, the binning itself works in normalised device coordinates and needs nothing new
+/// </summary>
+void LightClusterGrid::SetScreenSize(vec2 screenSize) {
+	this->screenSize = screenSize;
+}
+
+/// <summary>
+/// Bins every light into the clusters its range sphere overlaps.
+/// Per slice the sphere's bounding box is projected at the slice's nearest and farthest depth inside the sphere,
+/// which covers the box's screen extent over the whole slice, so the tile rectangle is conservative.
+/// </summary>
+/// <param name="view">Same view matrix as FrameUniforms</param>
+/// <param name="fovY">Vertical field of view in radians</param>
+void LightClusterGrid::Build(const PointLightBuffer& lights, const mat4& view, float fovY, float aspect) {
+	const vector<PointLight>& pointLights = lights.GetLights();
+	const vector<float>& ranges = lights.GetRanges();
+
+	vec2 tanHalfFov = vec2(tan(fovY * 0.5f) * aspect, tan(fovY * 0.5f));
+	vec2 tiles = vec2(tilesX, tilesY);
+
+	spans.clear();
+	for (size_t i = 0; i < pointLights.size(); i++)
+	{
+		float range = ranges[i];
+		if (range <= 0.0f)
+		{
+			continue;
+		}
+
+		vec3 centre = vec3(view * vec4(pointLights[i].position, 1.0f));
+		//View space looks down -z, depth is the distance in front of the camera
+		float centreDepth = -centre.z;
+		float minDepth = std::max(centreDepth - range, nearPlane);
+		float maxDepth = std::min(centreDepth + range, farPlane);
+		if (minDepth > maxDepth)
+		{
+			continue;
+		}
+
+		int firstSlice = DepthSlice(minDepth);
+		int lastSlice = DepthSlice(maxDepth);
+		for (int slice = firstSlice; slice <= lastSlice; slice++)
+		{
+			float sliceNear = std::max(minDepth, SliceDepth(slice));
+			float sliceFar = std::min(maxDepth, SliceDepth(slice + 1));
+
+			//x / depth is monotonic in depth, so its extremes over the slice are at one end or the other
+			vec2 lowCorner = vec2(centre) - range;
+			vec2 highCorner = vec2(centre) + range;
+			vec2 low = min(lowCorner / sliceNear, lowCorner / sliceFar) / tanHalfFov;
+			vec2 high = max(highCorner / sliceNear, highCorner / sliceFar) / tanHalfFov;
+			if (any(greaterThan(low, vec2(1.0f))) || any(lessThan(high, vec2(-1.0f))))
+			{
+				continue;
+			}
+
+			ClusterSpan span;
+			span.light = (unsigned int)i;
+			span.slice = slice;
+			span.minTile = clamp(ivec2(floor((low * 0.5f + 0.5f) * tiles)), ivec2(0), ivec2(tilesX - 1, tilesY - 1));
+			span.maxTile = clamp(ivec2(floor((high * 0.5f + 0.5f) * tiles)), ivec2(0), ivec2(tilesX - 1, tilesY - 1));
+			spans.push_back(span);
+		}
+	}
+
+	//--- Count per cluster, turn the counts into offsets, then fill, so the list is built without per cluster vectors
+	fill(clusters.begin(), clusters.end(), uvec2(0));
+	for (const ClusterSpan& span : spans)
+	{
+		for (int y = span.minTile.y; y <= span.maxTile.y; y++)
+		{
+			for (int x = span.minTile.x; x <= span.maxTile.x; x++)
+			{
+				clusters[(span.slice * tilesY + y) * tilesX + x].y++;
+			}
+		}
+	}
+
+	unsigned int offset = 0;
+	for (uvec2& cluster : clusters)
+	{
+		cluster.x = offset;
+		offset += cluster.y;
+		cluster.y = 0;
+	}
+
+	lightIndices.resize(offset);
+	for (const ClusterSpan& span : spans)
+	{
+		for (int y = span.minTile.y; y <= span.maxTile.y; y++)
+		{
+			for (int x = span.minTile.x; x <= span.maxTile.x; x++)
+			{
+				uvec2& cluster = clusters[(span.slice * tilesY + y) * tilesX + x];
+				lightIndices[cluster.x + cluster.y] = span.light;
+				cluster.y++;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Sends the cluster table and index list built this frame. The index buffer grows by doubling.
+/// </summary>
+void LightClusterGrid::Upload() {
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, clusterCount * sizeof(uvec2), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, clusterCount * sizeof(uvec2), clusters.data());
+
+	while (indexCapacity < lightIndices.size())
+	{
+		indexCapacity *= 2;
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, indexCapacity * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, lightIndices.size() * sizeof(unsigned int), lightIndices.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusterGrid::CleanUp() {
+	glDeleteTextures(1, &clusterTexture);
+	glDeleteTextures(1, &indexTexture);
+	glDeleteBuffers(1, &clusterBuffer);
+	glDeleteBuffers(1, &indexBuffer);
+	clusterTexture = indexTexture = clusterBuffer = indexBuffer = 0;
+}
+
+size_t LightClusterGrid::GetIndexCount() const {
+	return lightIndices.size();
+}
+
+/// <summary>
+/// Near boundary of a slice, slices are spaced evenly in log depth so each is about as deep as it is wide
+/// </summary>
+float LightClusterGrid::SliceDepth(int slice) const {
+	return nearPlane * pow(farPlane / nearPlane, (float)slice / slices);
+}
+
+int LightClusterGrid::DepthSlice(float depth) const {
+	int slice = (int)floor(log(depth / nearPlane) / log(farPlane / nearPlane) * slices);
+	return std::min(std::max(slice, 0), slices - 1);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "PointLightBuffer.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Clustered light culling. The view frustum is cut into screen tiles and exponentially spaced depth slices,
+/// and every frame each point light's range sphere is binned into the clusters it touches.
+/// The lit fragment shaders find their own cluster and shade only the lights listed for it,
+/// so a light costs the fragments near it rather than every fragment on screen.
+/// Two buffer textures go to the GPU: per cluster an offset and count into the index list, and the index list itself,
+/// each index being a light's position in PointLightBuffer.
+/// </summary>
+class LightClusterGrid
+{
+public:
+	static const int tilesX = 16;
+	static const int tilesY = 9;
+	static const int slices = 24;
+	static const int clusterCount = tilesX * tilesY * slices;
+
+	LightClusterGrid();
+	void Create(int clusterTextureUnit, int indexTextureUnit, vec2 screenSize, float nearPlane, float farPlane);
+	void Attach(Shader& shader) const;
+	void SetScreenSize(vec2 screenSize);
+	void Build(const PointLightBuffer& lights, const mat4& view, float fovY, float aspect);
+	void Upload();
+	void CleanUp();
+
+	size_t GetIndexCount() const;
+
+private:
+	//One light's tile rectangle within one slice, gathered before the list is laid out
+	struct ClusterSpan
+	{
+		unsigned int light;
+		int slice;
+		ivec2 minTile;
+		ivec2 maxTile;
+	};
+
+	vec2 screenSize = vec2(1.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	int clusterTextureUnit = 0;
+	int indexTextureUnit = 0;
+
+	//Per cluster, x offset into lightIndices and y count
+	vector<uvec2> clusters;
+	vector<unsigned int> lightIndices;
+	vector<ClusterSpan> spans;
+
+	unsigned int clusterBuffer = 0;
+	unsigned int clusterTexture = 0;
+	unsigned int indexBuffer = 0;
+	unsigned int indexTexture = 0;
+	//In indices
+	size_t indexCapacity = 0;
+
+	float SliceDepth(int slice) const;
+	int DepthSlice(float depth) const;
+};
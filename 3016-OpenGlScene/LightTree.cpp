@@ -0,0 +1,173 @@
+#include "LightTree.h"
+
+#include <algorithm>
+#include <cfloat>
+
+const size_t initialNodeCapacity = 64;
+
+LightTree::LightTree() {
+}
+
+/// <summary>
+/// Allocates the node buffer texture and leaves it bound to textureUnit. Needs a current GL context.
+/// </summary>
+void LightTree::Create(int textureUnit) {
+	this->textureUnit = textureUnit;
+	capacity = initialNodeCapacity;
+	texels.reserve(capacity * texelsPerNode);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity * texelsPerNode * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+/// <summary>
+/// Sets the texture unit and error bounds on a lit program, attach again after changing them
+/// </summary>
+void LightTree::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("lightTreeNodes", textureUnit);
+	shader.setFloat("lightTreeErrorBound", errorBound);
+	shader.setFloat("lightTreeRelativeError", relativeError);
+}
+
+/// <summary>
+/// Builds the tree over the lights just packed into PointLightBuffer, splitting each node's lights at the median
+/// along the longest side of their bounds. Node 0 is the root, with no lights there is no tree and nothing to walk.
+/// </summary>
+void LightTree::Build(const PointLightBuffer& lights) {
+	this->lights = &lights;
+	size_t lightCount = lights.GetLights().size();
+
+	order.resize(lightCount);
+	brightness.resize(lightCount);
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		const PointLight& light = lights.GetLights()[i];
+		vec3 total = light.ambient + light.diffuse + light.specular;
+		order[i] = (unsigned int)i;
+		brightness[i] = std::max(total.r, std::max(total.g, total.b));
+	}
+
+	//A binary tree with a light at every leaf has one node fewer than twice its leaves
+	size_t nodeCount = lightCount > 0 ? lightCount * 2 - 1 : 0;
+	texels.assign(nodeCount * texelsPerNode, vec4(0.0f));
+	if (lightCount > 0)
+	{
+		nextNode = 1;
+		BuildNode(0, 0, lightCount);
+	}
+}
+
+/// <summary>
+/// Orphans the buffer and writes this frame's nodes into it. Grows by doubling like PointLightBuffer.
+/// </summary>
+void LightTree::Upload() {
+	size_t nodeCount = texels.size() / texelsPerNode;
+	while (capacity < nodeCount)
+	{
+		capacity *= 2;
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity * texelsPerNode * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, texels.size() * sizeof(vec4), texels.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightTree::CleanUp() {
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &buffer);
+	texture = buffer = 0;
+}
+
+size_t LightTree::GetNodeCount() const {
+	return texels.size() / texelsPerNode;
+}
+
+/// <summary>
+/// Fills in one node from order[first, first + count), building its children first when it has more than one light
+/// </summary>
+void LightTree::BuildNode(int node, size_t first, size_t count) {
+	const vector<PointLight>& pointLights = lights->GetLights();
+	const vector<float>& ranges = lights->GetRanges();
+	vec4* nodeTexels = &texels[(size_t)node * texelsPerNode];
+
+	if (count == 1)
+	{
+		unsigned int index = order[first];
+		const PointLight& light = pointLights[index];
+		nodeTexels[0] = vec4(light.position, light.constant);
+		nodeTexels[1] = vec4(light.ambient, light.linear);
+		nodeTexels[2] = vec4(light.diffuse, light.quadratic);
+		nodeTexels[3] = vec4(light.specular, ranges[index]);
+		nodeTexels[4] = vec4(light.position, brightness[index]);
+		nodeTexels[5] = vec4(light.position, -1.0f - (float)index);
+		return;
+	}
+
+	//--- Split at the median along the longest side
+	vec3 minCorner = vec3(FLT_MAX);
+	vec3 maxCorner = vec3(-FLT_MAX);
+	for (size_t i = first; i < first + count; i++)
+	{
+		minCorner = min(minCorner, pointLights[order[i]].position);
+		maxCorner = max(maxCorner, pointLights[order[i]].position);
+	}
+	vec3 size = maxCorner - minCorner;
+	int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+	size_t half = count / 2;
+	nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](unsigned int a, unsigned int b) {
+		return pointLights[a].position[axis] < pointLights[b].position[axis];
+	});
+
+	int child = nextNode;
+	nextNode += 2;
+	BuildNode(child, first, half);
+	BuildNode(child + 1, first + half, count - half);
+
+	//--- Aggregate, colours summed at the brightness weighted centre of the members
+	vec3 ambient = vec3(0.0f);
+	vec3 diffuse = vec3(0.0f);
+	vec3 specular = vec3(0.0f);
+	vec3 centre = vec3(0.0f);
+	float totalBrightness = 0.0f;
+	//Weakest attenuation of any member, so the aggregate never falls off faster than what it stands in for
+	float constant = FLT_MAX;
+	float linear = FLT_MAX;
+	float quadratic = FLT_MAX;
+	for (size_t i = first; i < first + count; i++)
+	{
+		const PointLight& light = pointLights[order[i]];
+		ambient += light.ambient;
+		diffuse += light.diffuse;
+		specular += light.specular;
+		centre += light.position * brightness[order[i]];
+		totalBrightness += brightness[order[i]];
+		constant = std::min(constant, light.constant);
+		linear = std::min(linear, light.linear);
+		quadratic = std::min(quadratic, light.quadratic);
+	}
+	centre = totalBrightness > 0.0f ? centre / totalBrightness : (minCorner + maxCorner) * 0.5f;
+
+	//Reaches as far as its furthest reaching member does, measured from the centre
+	float range = 0.0f;
+	for (size_t i = first; i < first + count; i++)
+	{
+		range = std::max(range, ranges[order[i]] + length(pointLights[order[i]].position - centre));
+	}
+
+	vec3 total = ambient + diffuse + specular;
+	nodeTexels[0] = vec4(centre, constant);
+	nodeTexels[1] = vec4(ambient, linear);
+	nodeTexels[2] = vec4(diffuse, quadratic);
+	nodeTexels[3] = vec4(specular, range);
+	nodeTexels[4] = vec4(minCorner, std::max(total.r, std::max(total.g, total.b)));
+	nodeTexels[5] = vec4(maxCorner, (float)child);
+}
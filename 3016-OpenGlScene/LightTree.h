@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "PointLightBuffer.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Lightcuts style light hierarchy. Every frame the lights are split into a binary tree by position, each node holding
+/// one aggregate light standing in for everything under it: the members' colours summed at their brightness weighted centre.
+/// A lit fragment walks the tree from the root. A node whose range doesn't reach the fragment is skipped,
+/// and a node far enough away that swapping its members for its aggregate can't be off by more than the error bounds
+/// is shaded as that one light. Otherwise its children are tried. A distant crowd of bubble lights costs a handful
+/// of aggregates, so the cost grows with how finely the lights have to be resolved rather than how many there are.
+/// The aggregate is only exact for members that share attenuation, which every light in the scene does.
+/// </summary>
+class LightTree
+{
+public:
+	//--- Texels per node, see FetchTreeLight in FragmentShader.f
+	//0-3: the aggregate light, laid out as in PointLightBuffer
+	//4: xyz bounds minimum, w brightest channel of the summed colours
+	//5: xyz bounds maximum, w first child, the second follows it, or for a single light -1 - its index in PointLightBuffer
+	static const int texelsPerNode = 6;
+	//Deepest a fragment's walk can go, the shaders' stack size. Median splits keep the tree this shallow up to 2^31 lights.
+	static const int maxDepth = 32;
+
+	LightTree();
+	void Create(int textureUnit);
+	void Attach(Shader& shader) const;
+	void Build(const PointLightBuffer& lights);
+	void Upload();
+	void CleanUp();
+
+	size_t GetNodeCount() const;
+
+	//--- Largest change to a fragment's colour, per channel, that shading a group as its aggregate is allowed to make.
+	//Whichever is larger of a fixed amount and a fraction of the light the fragment has gathered so far, a small error is lost in a bright pixel.
+	float errorBound = 2.0f / 255.0f;
+	float relativeError = 0.02f;
+
+private:
+	const PointLightBuffer* lights = NULL;
+	int textureUnit = 0;
+
+	vector<vec4> texels;
+	//Scratch for Build, light indices reordered so each node's members are contiguous
+	vector<unsigned int> order;
+	vector<float> brightness;
+	int nextNode = 0;
+
+	unsigned int buffer = 0;
+	unsigned int texture = 0;
+	//In nodes
+	size_t capacity = 0;
+
+	void BuildNode(int node, size_t first, size_t count);
+};
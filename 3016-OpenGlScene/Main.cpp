@@ -6,16 +6,26 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <cfloat>
+#include <cstdlib>
 #include <iostream>
 #include <map>
 #include <math.h>
-#include <random>
+#include <thread>
 #include <vector>
 
-#include "ArcingProjectileObject.h"
+#include "AnalyticBubbleSystem.h"
+#include "Benchmarks.h"
+#include "BubbleRenderer.h"
+#include "BubbleSimulation.h"
 #include "Camera.h"
 #include "CustomSceneObject.h"
+#include "DeferredRenderer.h"
+#include "DrawLightAssigner.h"
+#include "FrameUniformBuffer.h"
 #include "Model.h"
+#include "ObjectPool.h"
+#include "PhiloxRandom.h"
 #include "Shader.h"
 
 #include <assimp/Importer.hpp>
@@ -25,8 +35,19 @@
 #include <irrklang/irrKlang.h>
 
 #include "FastNoiseLite.h"
+#include "GpuBubbleSimulation.h"
+#include "IrradianceProbeGrid.h"
+#include "LightAnimationSet.h"
+#include "LightClusterGrid.h"
+#include "LightTree.h"
 
 #include "PointLight.h"
+#include "PointLightBuffer.h"
+#include "ProjectileParticleStore.h"
+#include "ShadowCubeCache.h"
+#include "SignificanceManager.h"
+#include "StaticLightBake.h"
+#include "WindField.h"
 
 
 using namespace glm;
@@ -43,6 +64,12 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 //--- Screen settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+//Framebuffer size in pixels, which differs from the window size on HiDPI displays and changes when the window is resized.
+//Whatever is sized to it is resized at the start of the next frame
+ivec2 framebufferSize = ivec2(SCR_WIDTH, SCR_HEIGHT);
+bool framebufferResized = false;
+const float nearPlane = 0.1f;
+const float farPlane = 100.0f;
 
 //--- Proc gen globals
 const unsigned int RENDER_DISTANCE = 128;
@@ -67,8 +94,35 @@ float lastFrame = 0.0f;
 //--- Scene object containers
 map<string, CustomSceneObject*> sceneObjectDictionary;
 
-vector<ArcingProjectileObject*> projectileObjects;
-map<ArcingProjectileObject*, ISound*> bubbleSounds;
+//Bubbles are simulated on their own thread, the render loop reads interpolated handles and positions each frame.
+//The sound and light pools are kept in the same order, bubbleOwners holds the bubble each pool entry belongs to
+ObjectPool<ISound*> bubbleSounds;
+vector<ProjectileHandle> bubbleOwners;
+vector<ProjectileHandle> bubbleHandles;
+vector<vec3> bubblePositions;
+//Bubbles spawned and popped since the last frame, only these start or stop a sound and light
+vector<BubbleChange> bubbleChanges;
+//Bubble slot -> pool index, -1 when the slot's bubble has no pool entry
+vector<int> bubbleSlotToPool;
+//False while another mode is on and the pools have been handed back
+bool bubblePoolsTrackSimulation = true;
+
+//--- Bubble significance
+//Every live bubble holds a pooled sound and light, but only the most significant on screen get them switched on.
+//Lights are culled per cluster, a bubble light only costs the fragments near it, so every bubble can have one
+SignificanceManager bubbleSignificance;
+const size_t maxBubbleLights = 24;
+const size_t maxBubbleVoices = 6;
+//Bubbles that drift on the wind every simulation tick, the rest drift every few ticks
+const size_t maxFullRateBubbles = 8;
+//Lights of the bubbles that won one this frame, uploaded at the start of the next
+vector<PointLight> litBubbleLights;
+//--- Irradiance probes
+//With them on only the most significant bubbles get a point light, the rest light the scene through the probes. P toggles them
+IrradianceProbeGrid irradianceProbes;
+bool useIrradianceProbes = true;
+bool useIrradianceProbesKeyPressed = false;
+const size_t maxBubbleLightsWithProbes = 6;
 
 //--- Sphere object constants
 const float sphereRadius = 1.2f;
@@ -76,6 +130,60 @@ const int longitudeSteps = 36;
 const int latitudeSteps = 18;
 const int sphereVerticesCount = latitudeSteps * longitudeSteps;
 const int sphereIndicesCount = (longitudeSteps - 1) * (latitudeSteps - 1) * 6;
+const float bubbleDisplacementScale = 0.4f;
+
+//--- Bubble impostor settings
+//Beyond this distance a bubble is drawn as a camera facing quad that ray casts the sphere instead of the full mesh
+bool useBubbleImpostors = true;
+bool impostorKeyPressed = false;
+float bubbleImpostorDistance = 18.0f;
+//Average displaced radius, noise is 0-1 so the mesh surface sits around half the displacement out
+const float bubbleImpostorRadius = sphereRadius + bubbleDisplacementScale * 0.5f;
+
+//--- Bubble simulation
+//Fixed 60hz tick, bubbles push apart from each other and are pushed out of the trees and the wall using the same average radius
+BubbleSimulation bubbleSimulation(bubbleImpostorRadius, 60.0);
+//G cycles through the ways bubbles can be simulated. Only the CPU simulation's bubbles carry lights and sounds,
+//they are released while another mode is on
+enum BubbleMode {
+	BUBBLES_CPU_THREAD,
+	//Simulated and relaunched by transform feedback, drawn from the same buffer
+	BUBBLES_GPU_TRANSFORM_FEEDBACK,
+	//Launches written once, positions worked out by the sphere shaders from time
+	BUBBLES_ANALYTIC_SHADER,
+	BUBBLE_MODE_COUNT
+};
+BubbleMode bubbleMode = BUBBLES_CPU_THREAD;
+bool bubbleModeKeyPressed = false;
+
+GpuBubbleSimulation gpuBubbles;
+const size_t gpuBubbleCount = 2048;
+const size_t gpuBubbleLaunchCount = 8192;
+
+AnalyticBubbleSystem analyticBubbles;
+const size_t analyticBubbleCapacity = 1024;
+
+//--- Bubble wind
+//Curl noise drift for the CPU and GPU simulations, one grid node every 4 units over the area bubbles can reach.
+//The analytic bubbles keep pure arcs, their positions come from time alone with nothing to accumulate drift into
+WindField bubbleWind;
+const ivec3 windResolution = ivec3(32, 8, 32);
+const vec3 windOrigin = vec3(-64.0f, 0.0f, -64.0f);
+const vec3 windExtent = vec3(128.0f, 32.0f, 128.0f);
+const float windFrequency = 0.04f;
+//Fastest gust in units a second, bubbles themselves fly at around 1
+const float windStrength = 0.6f;
+
+//--- Camera, time and global lights, uploaded once a frame and shared by every scene program
+FrameUniformBuffer frameUniforms;
+//The torch's cone never changes, so its cosines are worked out once
+const float spotLightCutOff = glm::cos(glm::radians(12.5f));
+const float spotLightOuterCutOff = glm::cos(glm::radians(15.0f));
+//Tree.obj is a short trunk under a wide crown, one sphere each fitted by eye to the model
+const float treeTrunkHeight = 0.8f;
+const float treeTrunkRadius = 0.5f;
+const float treeCrownHeight = 3.6f;
+const float treeCrownRadius = 2.2f;
 
 // -- Texture holder
 map<string, unsigned int> texNameToId;
@@ -83,15 +191,23 @@ map<string, unsigned int> texNameToUnitNo;
 int currentUnit = 0;
 
 //-- For random number generation
-random_device rd; //Seed generation
-mt19937 gen(rd()); //Random value generator using the this mt19937 method. Creates large integers
-uniform_real_distribution<> dis(0.0, 1.0);
+//Same seed gives the same trees, terrain and bubble launches every run, change with --seed <number>
+uint64_t sceneSeed = 3016;
+//One stream per system so drawing more values in one never shifts another
+PhiloxRandom treeRandom;
+PhiloxRandom terrainRandom;
+PhiloxRandom gpuBubbleRandom;
+PhiloxRandom windRandom;
 
 //-- Audio
 bool isPlayingBackgroundAudio = true;
 ISoundEngine* audioEngine;
 ISound* backgroundSound;
 bool spacePressed = false;
+
+//-- Uniform uploads
+//Setting a uniform to the value it already holds is skipped, U prints how many were sent and skipped last frame
+bool uniformCountsKeyPressed = false;
 #pragma endregion Globals and settings
 
 
@@ -101,6 +217,10 @@ void CreateObject(string name, float vertices[], int verticesElementCount, unsig
 void LoadTexture(unsigned int& textureId, const char* filePath);
 void CreateProceduralTerrain(float* terrainVertices, int terrainVerticesCount);
 void CreateSphereObject(float sphereVertices[latitudeSteps][longitudeSteps][11], unsigned int sphereIndices[(longitudeSteps - 1) * (latitudeSteps - 1) * 6]);
+int FindBubblePoolIndex(ProjectileHandle handle);
+void DrawShadowCasters(Shader& depthShader, const Model& treeModel, int numberOfTrees, const mat4& singleTreeModelMatrix, const Model& wallModel, const mat4& wallModelMatrix);
+struct LitShaderUniforms FindLitShaderUniforms(const Shader& shader);
+struct BubbleShaderUniforms FindBubbleShaderUniforms(const Shader& shader);
 
 
 #pragma region Structures
@@ -111,15 +231,109 @@ struct Point {
 
 int maxPointLights = 8;
 vector<PointLight*> staticPointLights;
-map<ArcingProjectileObject*, PointLight*> dynamicBubbleLights;
-vector<PointLight*> dynamicPointLights;
+ObjectPool<PointLight> dynamicPointLights;
+//Lamps and lit bubbles, repacked and uploaded once a frame for every lit program
+PointLightBuffer pointLightBuffer;
+//Lamp flicker, the shaders play it from the frame's time
+LightAnimationSet lightAnimations;
+//--- Point light culling, which of pointLightBuffer's lights a lit fragment loops over. Matches the shaders' defines.
+enum PointLightMode {
+	POINT_LIGHTS_ALL,
+	//Binned by screen tile and depth, the lit shaders only loop over their own cluster's lights
+	POINT_LIGHTS_CLUSTERED,
+	//The strongest few that reach each draw's bounds
+	POINT_LIGHTS_PER_DRAW,
+	//Lit draws go to a G-buffer and each light shades only the pixels inside its range
+	POINT_LIGHTS_DEFERRED,
+	//Groups of lights far enough away are shaded as one aggregate light, see LightTree
+	POINT_LIGHTS_TREE,
+	POINT_LIGHT_MODE_COUNT
+};
+PointLightMode pointLightMode = POINT_LIGHTS_CLUSTERED;
+bool pointLightModeKeyPressed = false;
+LightClusterGrid lightClusters;
+DrawLightAssigner drawLights;
+DeferredRenderer deferredRenderer;
+LightTree lightTree;
+//Rough bounding radius of a lamp model at its drawn scale
+const float lampBoundsRadius = 1.0f;
+//The lamps never move and share one colour, so their lighting is baked at startup and only scaled by the colour each frame.
+//B swaps back to lighting them as point lights, to compare against
+StaticLightBake staticLighting;
+bool bakeStaticLamps = true;
+bool bakeStaticLampsKeyPressed = false;
+//Lamp shadows are rendered once and kept, a face is only drawn again when something in it changes. At most this many faces a frame
+ShadowCubeCache lampShadows;
+const int shadowFaceBudget = 2;
+//--- Uniforms the render loop sets every frame, found once before it starts so setting them needs no lookup by name.
+//The plane's and the models' shaders share their lighting uniforms, a handle a program doesn't have is left inactive
+struct LitShaderUniforms {
+	UniformHandle<mat4> model;
+	UniformHandle<bool> useInstancing;
+	UniformHandle<bool> useTexture;
+	UniformHandle<int> texture1;
+	UniformHandle<int> textureDiffuse1;
+	UniformHandle<bool> useStaticLightMap;
+	UniformHandle<int> pointLightMode;
+	UniformHandle<vec3> staticLampDiffuse;
+	UniformHandle<vec3> staticLampAmbient;
+	UniformHandle<int> shadowedLightCount;
+	UniformHandle<bool> useIrradianceProbes;
+	UniformHandle<ivec2> drawLights;
+	UniformHandle<ivec2> staticLightBake;
+};
+//Both bubble shaders, the mesh and the impostor
+struct BubbleShaderUniforms {
+	UniformHandle<mat4> model;
+	UniformHandle<bool> useInstancing;
+	UniformHandle<float> displacementScale;
+	UniformHandle<int> firstNoiseTexture;
+	UniformHandle<int> secondNoiseTexture;
+	UniformHandle<bool> analyticTrajectory;
+	UniformHandle<float> gravity;
+	UniformHandle<vec3> lightPos;
+	UniformHandle<vec3> lightColour;
+	UniformHandle<vec3> lightPosition;
+	UniformHandle<vec3> lightAmbient;
+	UniformHandle<vec3> lightDiffuse;
+	UniformHandle<vec3> lightSpecular;
+};
 #pragma endregion Structures
 
 
 
 
-int main()
+int main(int argc, char* argv[])
 {
+	//--- Command line options
+	bool runBenchmarks = false;
+	for (int i = 1; i < argc; i++)
+	{
+		string argument = argv[i];
+		if (argument == "--benchmark")
+		{
+			runBenchmarks = true;
+		}
+		else if (argument == "--seed" && i + 1 < argc)
+		{
+			sceneSeed = strtoull(argv[++i], NULL, 10);
+		}
+	}
+
+	//--- Headless benchmark run, skips the window entirely
+	if (runBenchmarks)
+	{
+		RunBenchmarks();
+		return 0;
+	}
+
+	treeRandom.Seed(sceneSeed, 0);
+	bubbleSimulation.SeedRandom(sceneSeed, 1);
+	terrainRandom.Seed(sceneSeed, 2);
+	gpuBubbleRandom.Seed(sceneSeed, 3);
+	analyticBubbles.SeedRandom(sceneSeed, 4);
+	windRandom.Seed(sceneSeed, 5);
+
 #pragma region OpenGl Setup
 	//--- Initialize GLFW
 	glfwInit();
@@ -160,7 +374,8 @@ int main()
 	}
 
 	//--- Enable depth buffer
-	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+	glfwGetFramebufferSize(window, &framebufferSize.x, &framebufferSize.y);
+	glViewport(0, 0, framebufferSize.x, framebufferSize.y);
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 	glEnable(GL_CULL_FACE);
@@ -288,6 +503,13 @@ int main()
 	int planeIndicesCount = sizeof(planeIndices) / sizeof(planeIndices[0]);
 
 	CreateObject("Plane Object", planeVertices, planeIndicesCount, planeIndices, planeIndicesCount, planeAttributeSizes, planeAttributeSize);
+	//Drawn at (0, 0, -20) scaled to 90 by 50
+	mat4 planeModelMatrix = mat4(1.0f);
+	planeModelMatrix = translate(planeModelMatrix, vec3(0.0f, 0.0f, -20.0f));
+	planeModelMatrix = scale(planeModelMatrix, vec3(90.0f, 1.0f, 50.0f));
+	planeModelMatrix = rotate(planeModelMatrix, radians(90.0f), vec3(1.0f, 0.0f, 0.0f));
+	vec3 planeBoundsCentre = vec3(0.0f, 0.0f, -20.0f);
+	float planeBoundsRadius = length(vec2(45.0f, 25.0f));
 
 #pragma endregion
 
@@ -330,10 +552,35 @@ int main()
 	// ------------------------
 	vec3 spawnCentre = vec3(0.0f, 0.0f, 0.0f);
 	float spawnRadius = 3.0f;
-	float projectileSpawnCooldown = 2.0f;
-	float projectileSpawnTimer = 0.0f;
-	int maxBubbles = 7;
-	int currentBubbles = 0;
+	//Lights and voices are budgeted by significance, so this only bounds the pools
+	int maxBubbles = 24;
+
+	// ---------------------------
+	// Bubble pools
+	// ---------------------------
+	// Everything a bubble needs is created here, spawning and popping afterwards only moves things around
+	bubbleSimulation.SetMaxBubbles(maxBubbles);
+	bubbleSimulation.SetMaxFullRateUpdates(maxFullRateBubbles);
+	bubbleOwners.reserve(maxBubbles);
+	litBubbleLights.reserve(maxBubbleLights);
+	bubbleSignificance.maxLights = maxBubbleLights;
+	bubbleSignificance.maxVoices = maxBubbleVoices;
+	bubbleSignificance.maxFullRateUpdates = maxFullRateBubbles;
+
+	//One looping voice per possible bubble, started paused and unpaused when a bubble takes it
+	bubbleSounds.Allocate(maxBubbles, NULL);
+	for (size_t i = 0; i < bubbleSounds.Capacity(); i++)
+	{
+		ISound* sound = audioEngine->play3D("Media/Audio/bathtub-ambience-27873.mp3", vec3df(0.0f, 0.0f, 0.0f), true, true, true);
+		if (!sound) {
+			std::cerr << "Failed to load sound file for bubble" << std::endl;
+		}
+		else {
+			sound->setVolume(2.5f);
+			sound->setMinDistance(5.0f);
+		}
+		bubbleSounds.Data()[i] = sound;
+	}
 
 	// ---------------------------
 	// Shader
@@ -359,6 +606,80 @@ int main()
 	// -----------------------
 #pragma endregion
 
+#pragma region Sphere impostor
+	// ----------------------------------------
+	// Impostor quad for distant bubbles
+	// ----------------------------------------
+	// Only the corners are stored, the vertex shader expands them around the bubble centre each draw
+	float impostorQuadVertices[] = {
+		-1.0f, -1.0f, //bottom left
+		 1.0f, -1.0f, //bottom right
+		 1.0f,  1.0f, //top right
+		-1.0f,  1.0f  //top left
+	};
+
+	unsigned int impostorQuadIndices[] = {
+		0, 1, 2, //First triangle
+		2, 3, 0  //Second triangle
+	};
+
+	int impostorQuadAttributeSize = 2;
+	vector<int> impostorQuadAttributeSizes =
+	{
+		2 //Corner
+	};
+
+	int impostorQuadVerticesCount = sizeof(impostorQuadVertices) / (sizeof(impostorQuadVertices[0]) * impostorQuadAttributeSize);
+	int impostorQuadIndicesCount = sizeof(impostorQuadIndices) / sizeof(impostorQuadIndices[0]);
+
+	CreateObject("Impostor Quad", impostorQuadVertices, impostorQuadVerticesCount, impostorQuadIndices, impostorQuadIndicesCount, impostorQuadAttributeSizes, impostorQuadAttributeSize);
+
+	// ---------------------------
+	// Shader
+	// ---------------------------
+	// Material matches the sphere shader so the switch between the two is not noticeable
+	Shader sphereImpostorShader("Shaders/SphereImpostorVertexShader.v", "Shaders/SphereImpostorFragmentShader.f");
+
+	sphereImpostorShader.Use();
+	sphereImpostorShader.setVec3("material.ambient", 1.0f, 0.5f, 0.31f);
+	sphereImpostorShader.setVec3("material.diffuse", 85.0f / 255.0f, 140.0f / 255.0f, 158.0f / 255.0f);
+	sphereImpostorShader.setVec3("material.specular", 0.8f, 0.8f, 0.8f);
+	sphereImpostorShader.setFloat("material.shininess", 32.0f);
+	sphereImpostorShader.setFloat("impostorRadius", bubbleImpostorRadius);
+
+	// ---------------------------
+	// Instanced bubble rendering
+	// ---------------------------
+	// One draw for all bubble meshes and one for all impostors, positions are streamed in each frame
+	BubbleRenderer bubbleRenderer(
+		sceneObjectDictionary["Sphere Object"]->VAO, sphereIndicesCount,
+		sceneObjectDictionary["Impostor Quad"]->VAO, impostorQuadIndicesCount);
+
+	// ---------------------------
+	// GPU bubble simulation
+	// ---------------------------
+	// Launches are made up front from their own random stream, the buffers then never leave the GPU
+	texNameToUnitNo["bubbleLaunchTexture"] = 6;
+	gpuBubbles.Create(gpuBubbleCount, gpuBubbleLaunchCount, gpuBubbleRandom, texNameToUnitNo["bubbleLaunchTexture"]);
+
+	// ---------------------------
+	// Analytic bubbles
+	// ---------------------------
+	// Twenty times the CPU simulation's launch rate, a few hundred bubbles in the air once it fills up
+	analyticBubbles.Create(analyticBubbleCapacity);
+	analyticBubbles.spawnRate = 20.0f;
+
+	// ---------------------------
+	// Bubble wind
+	// ---------------------------
+	// Baked once, the simulation thread samples the grid and the GPU update pass samples the same grid as a texture
+	bubbleWind.Bake((int)windRandom.NextUInt(), windResolution, windOrigin, windExtent, windFrequency, windStrength);
+	texNameToUnitNo["windFieldTexture"] = 7;
+	bubbleWind.CreateTexture(texNameToUnitNo["windFieldTexture"]);
+	bubbleSimulation.SetWindField(&bubbleWind);
+	gpuBubbles.SetWindField(bubbleWind, texNameToUnitNo["windFieldTexture"]);
+#pragma endregion
+
 
 
 
@@ -389,8 +710,6 @@ int main()
 	TexturedObjectShader.setVec3("light.position", camera.Position);
 	TexturedObjectShader.setVec3("light.direction", camera.Front);
 	TexturedObjectShader.setFloat("light.cutOff", cos(radians(12.5f)));
-	TexturedObjectShader.setInt("staticPointLights", 4);
-	TexturedObjectShader.setInt("dynamicPointLights", 0);
 
 #pragma endregion
 
@@ -461,6 +780,17 @@ int main()
 		staticPointLights.push_back(newLight);
 	}
 
+	//Bubble lights, position is filled in on spawn and colour comes from bubbleLightColour in the render loop
+	dynamicPointLights.Allocate(maxBubbles, PointLight(
+		vec3(0.0f),
+		1.0f,
+		0.09f,
+		0.032f,
+		ambientLightColour,
+		lightColour,
+		lightColour
+	));
+
 
 
 
@@ -486,14 +816,26 @@ int main()
 	vec3 OrangeColour(212.0f / 255.0f, 164.0f / 255.0f, 116.0f / 255.0f);
 
 	const int lightNoiseTextureLength = 512;
-	int lightNoiseTextureCurrentIndex = 0;
 	float lightNoiseScale = 0.4f;
 
 	float lightNoiseValues[lightNoiseTextureLength];
 
+	//Noise from -1 to 1 moved to 0 to 1 along the ramp, red at the middle and orange at the top
 	for (int i = 0; i < lightNoiseTextureLength; i++)
 	{
-		lightNoiseValues[i] = lightColourNoiseGenerator.GetNoise((float)i * lightNoiseScale, 0.0f);
+		lightNoiseValues[i] = lightColourNoiseGenerator.GetNoise((float)i * lightNoiseScale, 0.0f) * 0.5f + 0.5f;
+	}
+	vec3 lampRamp[] = { RedColour - (OrangeColour - RedColour), OrangeColour };
+
+	lightAnimations.Create(lightNoiseTextureLength, 64);
+	LightAnimation lampFlicker;
+	lampFlicker.curve = lightAnimations.AddCurve(lightNoiseValues);
+	lampFlicker.ramp = lightAnimations.AddRamp(lampRamp, 2);
+	//Played through at 0.035 times a second. Every lamp starts at the same point, baked lamps have to share one colour.
+	lampFlicker.cyclesPerSecond = 0.035f;
+	for (PointLight* light : staticPointLights)
+	{
+		light->animation = lampFlicker;
 	}
 #pragma endregion
 
@@ -595,6 +937,28 @@ int main()
 	texNameToUnitNo["wallTexture"] = 3;
 	Model wallModel("Media/Wall/Wall.fbx", texNameToUnitNo["wallTexture"]);
 
+	mat4 wallModelMatrix = mat4(1.0f);
+	wallModelMatrix = scale(wallModelMatrix, vec3(0.8f, 0.8f, 0.8f));
+	wallModelMatrix = translate(wallModelMatrix, vec3(2.0f, 0.0f, 0.0f));
+	wallModelMatrix = rotate(wallModelMatrix, radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
+	wallModelMatrix = rotate(wallModelMatrix, radians(-90.0f), vec3(0.0f, 0.0f, 1.0f));
+
+	//--- Wall collider, world space bounds of every wall vertex
+	vec3 wallMinCorner = vec3(FLT_MAX);
+	vec3 wallMaxCorner = vec3(-FLT_MAX);
+	for (Mesh& mesh : wallModel.meshes)
+	{
+		for (Vertex& vertex : mesh.vertices)
+		{
+			vec3 worldPosition = vec3(wallModelMatrix * vec4(vertex.Position, 1.0f));
+			wallMinCorner = min(wallMinCorner, worldPosition);
+			wallMaxCorner = max(wallMaxCorner, worldPosition);
+		}
+	}
+	bubbleSimulation.GetCollisionSystem().AddStaticBox(wallMinCorner, wallMaxCorner);
+	vec3 wallBoundsCentre = (wallMinCorner + wallMaxCorner) * 0.5f;
+	float wallBoundsRadius = length(wallMaxCorner - wallMinCorner) * 0.5f;
+
 	texNameToUnitNo["lampTexture"] = 4;
 	Model lampModel("Media/Lamp/lamp.obj", texNameToUnitNo["lampTexture"]);
 
@@ -619,8 +983,73 @@ int main()
 	modelShader.setVec3("light.position", camera.Position);
 	modelShader.setVec3("light.direction", camera.Front);
 	modelShader.setFloat("light.cutOff", cos(radians(12.5f)));
-	modelShader.setInt("staticPointLights", 4);
-	modelShader.setInt("dynamicPointLights", 0);
+#pragma endregion
+
+#pragma region Per frame uniform buffer
+	frameUniforms.Create();
+	frameUniforms.Attach(TexturedObjectShader);
+	frameUniforms.Attach(sphereShader);
+	frameUniforms.Attach(sphereImpostorShader);
+	frameUniforms.Attach(ProceduralObjectShader);
+	frameUniforms.Attach(modelShader);
+
+	//Ambient stays a per program uniform since the textured objects and the models are lit differently, it never changes
+	TexturedObjectShader.Use();
+	TexturedObjectShader.setVec3("dirLightAmbient", ambientLightColour * 0.3f);
+	TexturedObjectShader.setVec3("spotLightAmbient", ambientLightColour);
+	modelShader.Use();
+	modelShader.setVec3("dirLightAmbient", ambientLightColour);
+	modelShader.setVec3("spotLightAmbient", vec3(0.1f, 0.1f, 0.1f));
+
+	texNameToUnitNo["pointLightTexture"] = 8;
+	pointLightBuffer.Create(texNameToUnitNo["pointLightTexture"]);
+	TexturedObjectShader.Use();
+	TexturedObjectShader.setInt("pointLightData", texNameToUnitNo["pointLightTexture"]);
+	modelShader.Use();
+	modelShader.setInt("pointLightData", texNameToUnitNo["pointLightTexture"]);
+
+	texNameToUnitNo["lightClusterTexture"] = 9;
+	texNameToUnitNo["lightClusterIndexTexture"] = 10;
+	lightClusters.Create(texNameToUnitNo["lightClusterTexture"], texNameToUnitNo["lightClusterIndexTexture"], vec2(framebufferSize), nearPlane, farPlane);
+	lightClusters.Attach(TexturedObjectShader);
+	lightClusters.Attach(modelShader);
+
+	texNameToUnitNo["drawLightIndexTexture"] = 11;
+	drawLights.Create(texNameToUnitNo["drawLightIndexTexture"]);
+	drawLights.Attach(TexturedObjectShader);
+	drawLights.Attach(modelShader);
+
+	//Five targets from this unit up
+	texNameToUnitNo["gBufferTexture"] = 12;
+	deferredRenderer.Create(framebufferSize.x, framebufferSize.y, texNameToUnitNo["gBufferTexture"], texNameToUnitNo["pointLightTexture"], frameUniforms);
+
+	texNameToUnitNo["lightTreeTexture"] = 19;
+	lightTree.Create(texNameToUnitNo["lightTreeTexture"]);
+	lightTree.Attach(TexturedObjectShader);
+	lightTree.Attach(modelShader);
+
+	//Over the floor and up to where the bubbles fly, about three units a cell. A slot per simulation slot, which never
+	//goes past the most bubbles alive at once. The static lamps stay out, their light is already baked or lit per pixel
+	texNameToUnitNo["irradianceProbeTexture"] = 21;
+	irradianceProbes.Create(maxBubbles, ivec3(30, 6, 17), vec3(-45.0f, 0.0f, -45.0f), vec3(90.0f, 16.0f, 50.0f), texNameToUnitNo["irradianceProbeTexture"]);
+	irradianceProbes.Attach(TexturedObjectShader);
+	irradianceProbes.Attach(modelShader);
+
+	texNameToUnitNo["lightAnimationCurveTexture"] = 22;
+	texNameToUnitNo["lightAnimationRampTexture"] = 23;
+	lightAnimations.Upload(texNameToUnitNo["lightAnimationCurveTexture"], texNameToUnitNo["lightAnimationRampTexture"]);
+	lightAnimations.Attach(TexturedObjectShader);
+	lightAnimations.Attach(modelShader);
+	lightAnimations.Attach(deferredRenderer.GetLightShader());
+	pointLightBuffer.SetAnimations(&lightAnimations);
+	//Baked lamps flicker the same as they do as point lights
+	vec4 lampFlickerTexel = vec4((float)lampFlicker.curve, (float)lampFlicker.ramp, lampFlicker.cyclesPerSecond, lampFlicker.phase);
+	TexturedObjectShader.Use();
+	TexturedObjectShader.setVec4("staticLampAnimation", lampFlickerTexel);
+	modelShader.Use();
+	modelShader.setVec4("staticLampAnimation", lampFlickerTexel);
+	//Leaves a core each to rendering and the bubble simulation
+	irradianceProbes.Start(std::max((int)thread::hardware_concurrency() - 2, 1));
 #pragma endregion
 
 
@@ -640,15 +1069,26 @@ int main()
 	int numberOfTrees = 120;
 
 
+	//All random values for the forest in one batch, x, z and rotation per tree
+	const int treeRandomsPerTree = 3;
+	vector<float> treeRandoms(numberOfTrees * treeRandomsPerTree);
+	treeRandom.FillFloats(treeRandoms.data(), treeRandoms.size());
+
+	//Corners of every tree's crown, for the forest draw's bounds
+	vec3 forestMinCorner = vec3(FLT_MAX);
+	vec3 forestMaxCorner = vec3(-FLT_MAX);
+
 	//Pre compute the instanced matrices on the cpu
 	mat4* treeModelMatrices;
 	treeModelMatrices = new mat4[numberOfTrees];
 	for (int i = 0; i < numberOfTrees; i++)
 	{
+		float* randoms = &treeRandoms[i * treeRandomsPerTree];
+
 		mat4 model = mat4(1.0);
-		float randomX = treeSpawnTopLeft.x + (treeSpawnBottomRight.x - treeSpawnTopLeft.x) * dis(gen);
+		float randomX = treeSpawnTopLeft.x + (treeSpawnBottomRight.x - treeSpawnTopLeft.x) * randoms[0];
 		float randomY = 0.0f;
-		float randomZ = treeSpawnTopLeft.z + (treeSpawnBottomRight.z - treeSpawnTopLeft.z) * dis(gen);
+		float randomZ = treeSpawnTopLeft.z + (treeSpawnBottomRight.z - treeSpawnTopLeft.z) * randoms[1];
 
 
 		vec3 spawnPosition = vec3(randomX, randomY, randomZ);
@@ -656,12 +1096,26 @@ int main()
 		model = translate(model, spawnPosition);
 
 		float rotationMin = 0.0f;
-		float rotationAmount = rotationMin + (359.0f - rotationMin) * dis(gen);
+		float rotationAmount = rotationMin + (359.0f - rotationMin) * randoms[2];
 		randomTreeRotations.push_back(rotationAmount);
 		model = rotate(model, radians(rotationAmount), vec3(0.0f, 1.0f, 0.0f));
 
 		treeModelMatrices[i] = model;
+
+		bubbleSimulation.GetCollisionSystem().AddStaticSphere(spawnPosition + vec3(0.0f, treeTrunkHeight, 0.0f), treeTrunkRadius);
+		bubbleSimulation.GetCollisionSystem().AddStaticSphere(spawnPosition + vec3(0.0f, treeCrownHeight, 0.0f), treeCrownRadius);
+		forestMinCorner = min(forestMinCorner, spawnPosition - vec3(treeCrownRadius, 0.0f, treeCrownRadius));
+		forestMaxCorner = max(forestMaxCorner, spawnPosition + vec3(treeCrownRadius, treeCrownHeight + treeCrownRadius, treeCrownRadius));
 	}
+	vec3 forestBoundsCentre = (forestMinCorner + forestMaxCorner) * 0.5f;
+	float forestBoundsRadius = length(forestMaxCorner - forestMinCorner) * 0.5f;
+	//The single tree drawn at the origin at 0.8 scale
+	bubbleSimulation.GetCollisionSystem().AddStaticSphere(vec3(0.0f, treeTrunkHeight * 0.8f, 0.0f), treeTrunkRadius * 0.8f);
+	bubbleSimulation.GetCollisionSystem().AddStaticSphere(vec3(0.0f, treeCrownHeight * 0.8f, 0.0f), treeCrownRadius * 0.8f);
+	mat4 singleTreeModelMatrix = scale(mat4(1.0f), vec3(0.8f, 0.8f, 0.8f));
+	vec3 singleTreeBoundsCentre = vec3(0.0f, treeCrownHeight * 0.8f * 0.5f, 0.0f);
+	float singleTreeBoundsRadius = (treeCrownHeight + treeCrownRadius) * 0.8f;
+
 
 	unsigned int instanceBuffer;
 	glGenBuffers(1, &instanceBuffer);
@@ -688,6 +1142,70 @@ int main()
 	glBindVertexArray(0);
 #pragma endregion
 
+#pragma region Static lamp bake
+	// ----------------------------------
+	// Lamp lighting baked for everything that doesn't move
+	// ----------------------------------
+	//The lamp models are drawn half a unit under their light
+	vector<mat4> lampModelMatrices;
+	for (vec3 lampPos : pointLightPositions)
+	{
+		mat4 lampTransform = mat4(1.0f);
+		lampTransform = translate(lampTransform, vec3(lampPos.x, lampPos.y - 0.5f, lampPos.z));
+		lampTransform = scale(lampTransform, vec3(0.2f, 0.2f, 0.2f));
+		lampModelMatrices.push_back(lampTransform);
+	}
+
+	//Every face is dirty to begin with, they're all drawn now so the bake can read them
+	texNameToUnitNo["lampShadowAtlas"] = 20;
+	lampShadows.Create(staticPointLights, 256, texNameToUnitNo["lampShadowAtlas"]);
+	lampShadows.Attach(TexturedObjectShader);
+	lampShadows.Attach(modelShader);
+	lampShadows.Attach(deferredRenderer.GetLightShader());
+	lampShadows.BeginUpdate(lampShadows.GetDirtyFaceCount());
+	while (lampShadows.NextFace())
+	{
+		DrawShadowCasters(lampShadows.GetDepthShader(), treeModel, numberOfTrees, singleTreeModelMatrix, wallModel, wallModelMatrix);
+	}
+	lampShadows.EndUpdate();
+	lampShadows.ReadBack();
+
+	for (PointLight* light : staticPointLights)
+	{
+		staticLighting.AddLight(*light);
+	}
+	staticLighting.SetShadows(&lampShadows);
+
+	vector<int> lampBakes;
+	for (const mat4& lampTransform : lampModelMatrices)
+	{
+		lampBakes.push_back(staticLighting.BakeModel(lampModel, lampTransform));
+	}
+	int forestBake = staticLighting.BakeInstances(treeModel.meshes[0], treeModelMatrices, numberOfTrees);
+	int singleTreeBake = staticLighting.BakeModel(treeModel, singleTreeModelMatrix);
+	int wallBake = staticLighting.BakeModel(wallModel, wallModelMatrix);
+	//The plane has no normals, it's baked facing up. Around a fifth of a unit a texel, lamps sit close enough to the floor that coarser blurs their pools
+	staticLighting.BakeLightMap(ivec2(512, 256), planeModelMatrix, vec3(0.0f, 1.0f, 0.0f));
+
+	texNameToUnitNo["staticLightVertexTexture"] = 17;
+	texNameToUnitNo["staticLightMapTexture"] = 18;
+	staticLighting.Upload(texNameToUnitNo["staticLightVertexTexture"], texNameToUnitNo["staticLightMapTexture"]);
+	staticLighting.Attach(TexturedObjectShader);
+	staticLighting.Attach(modelShader);
+#pragma endregion
+
+#pragma region Uniform handles
+	LitShaderUniforms texturedObjectUniforms = FindLitShaderUniforms(TexturedObjectShader);
+	LitShaderUniforms modelUniforms = FindLitShaderUniforms(modelShader);
+	BubbleShaderUniforms sphereUniforms = FindBubbleShaderUniforms(sphereShader);
+	BubbleShaderUniforms sphereImpostorUniforms = FindBubbleShaderUniforms(sphereImpostorShader);
+	UniformHandle<int> deferredShadowedLightCount = deferredRenderer.GetLightShader().uniform("shadowedLightCount");
+	UniformHandle<mat4> terrainModelUniform = ProceduralObjectShader.uniform("model");
+#pragma endregion
+
+	//--- Colliders are all added by now, the simulation thread takes over the bubbles from here
+	bubbleSimulation.Start();
+
 	// -----------------------------------
 	// Main render loop
 	// -----------------------------------
@@ -700,9 +1218,31 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// -------------------------------------
+		// Latest simulation state, blended between its last two ticks
+		bubbleSimulation.ReadInterpolated(bubbleHandles, bubblePositions, &bubbleChanges);
+		if (bubbleMode != BUBBLES_CPU_THREAD)
+		{
+			//Nothing drawn from the snapshot, and the CPU bubbles' sounds and lights are released below
+			bubbleHandles.clear();
+			bubblePositions.clear();
+		}
+
 		// -------------------------------------
 		// Poll user input
 		processInput(window);
+		//Anything U printed covered the frame before, counting starts again for this one
+		Shader::ResetUploadCounts();
+
+		//Cluster tiles are found from pixel positions and the G-buffer is blitted pixel for pixel, so both follow the framebuffer
+		if (framebufferResized)
+		{
+			framebufferResized = false;
+			lightClusters.SetScreenSize(vec2(framebufferSize));
+			lightClusters.Attach(TexturedObjectShader);
+			lightClusters.Attach(modelShader);
+			deferredRenderer.Resize(framebufferSize.x, framebufferSize.y);
+		}
 
 		//--------------------------------------
 		// Clear screen and set it to the random colour
@@ -719,29 +1259,13 @@ int main()
 		TexturedObjectShader.Use();
 
 #pragma region Shader view and projection update
-		mat4 projection = perspective(radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		mat4 projection = perspective(radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, nearPlane, farPlane);
 		mat4 view = camera.GetViewMatrix();
 
-		TexturedObjectShader.Use();
-		TexturedObjectShader.setMat4("projection", projection);
-		TexturedObjectShader.setMat4("view", view);
-		TexturedObjectShader.setVec3("viewPos", camera.Position);
-
-		sphereShader.Use();
-		sphereShader.setMat4("projection", projection);
-		sphereShader.setMat4("view", view);
-		sphereShader.setVec3("viewPos", camera.Position);
-
-		ProceduralObjectShader.Use();
-		ProceduralObjectShader.setMat4("projection", projection);
-		ProceduralObjectShader.setMat4("view", view);
-		ProceduralObjectShader.setVec3("viewPos", camera.Position);
-
-		modelShader.Use();
-		modelShader.setMat4("projection", projection);
-		modelShader.setMat4("view", view);
-		modelShader.setVec3("viewPos", camera.Position);
-
+		frameUniforms.data.projection = projection;
+		frameUniforms.data.view = view;
+		frameUniforms.data.viewPos = camera.Position;
+		frameUniforms.data.time = currentFrame;
 
 #pragma endregion
 
@@ -750,122 +1274,119 @@ int main()
 		// ------------------------------
 		// Light colour
 		// ----------------------------
-		lightNoiseTextureCurrentIndex = (int)(currentFrame * 0.035f * lightNoiseTextureLength) % lightNoiseTextureLength;
-		float noiseValue = lightNoiseValues[lightNoiseTextureCurrentIndex];
-
-
-		vec3 lightColour = RedColour + (OrangeColour - RedColour) * noiseValue;
 		vec3 dirLightColour = vec3(71.0f / 255.0f, 113.0f / 255.0f, 214.0f / 255.0f);
 		vec3 ambientLightColour = vec3(3.0f / 255.0f, 10.0f / 255.0f, 28.0f / 255.0f);
 		vec3 bubbleLightColour = vec3(78.0f / 255.0f, 146.0f / 255.0f, 156.0f / 255.0f);
 
 		// ------------------------------
-		// Cube and plane lighting update
+		// Shared lights, one upload for every program
 		// -----------------------------
 		// directional light
-
-		TexturedObjectShader.Use();
-		TexturedObjectShader.setVec3("dirLight.direction", -0.7f, -1.0f, 0.7f);
-		TexturedObjectShader.setVec3("dirLight.ambient", ambientLightColour.x * 0.3, ambientLightColour.y * 0.3, ambientLightColour.z * 0.3);
-		TexturedObjectShader.setVec3("dirLight.diffuse", dirLightColour.x, dirLightColour.y, dirLightColour.z);
-		TexturedObjectShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// pointLights
-		int pointLightIndex = 0;
-		string pointLightUniformTag;
-		for (PointLight* light : staticPointLights) {
-			pointLightUniformTag = ("pointLights[" + to_string(pointLightIndex) + "]");
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".position", light->position);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".diffuse", lightColour);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".specular", lightColour);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".constant", light->constant);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".linear", light->linear);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".quadratic", light->quadratic);
-			pointLightIndex++;
+		frameUniforms.data.dirLightDirection = vec3(-0.7f, -1.0f, 0.7f);
+		frameUniforms.data.dirLightDiffuse = dirLightColour;
+		frameUniforms.data.dirLightSpecular = vec3(0.5f, 0.5f, 0.5f);
+		// spotLight
+		frameUniforms.data.spotLightPosition = camera.Position;
+		frameUniforms.data.spotLightDirection = camera.Front;
+		frameUniforms.data.spotLightDiffuse = vec3(1.0f, 1.0f, 1.0f);
+		frameUniforms.data.spotLightSpecular = vec3(1.0f, 1.0f, 1.0f);
+		frameUniforms.data.spotLightConstant = 1.0f;
+		frameUniforms.data.spotLightLinear = 0.09f;
+		frameUniforms.data.spotLightQuadratic = 0.032f;
+		frameUniforms.data.spotLightCutOff = spotLightCutOff;
+		frameUniforms.data.spotLightOuterCutOff = spotLightOuterCutOff;
+		// pointLights, lamps first unless they're baked, then the bubbles that won a light last frame
+		pointLightBuffer.BeginFrame();
+		if (!bakeStaticLamps) {
+			for (PointLight* light : staticPointLights) {
+				pointLightBuffer.Add(*light);
+			}
 		}
+		for (PointLight& light : litBubbleLights) {
+			light.diffuse = bubbleLightColour;
+			light.specular = bubbleLightColour;
+			pointLightBuffer.Add(light);
+		}
+		pointLightBuffer.Upload();
+		frameUniforms.data.pointLightCount = pointLightBuffer.GetLightCount();
+		frameUniforms.Upload();
 
-
-		for (PointLight* light : dynamicPointLights) {
-			pointLightUniformTag = ("pointLights[" + to_string(pointLightIndex) + "]");
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".position", light->position);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".diffuse", bubbleLightColour);
-			TexturedObjectShader.setVec3(pointLightUniformTag + ".specular", bubbleLightColour);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".constant", light->constant);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".linear", light->linear);
-			TexturedObjectShader.setFloat(pointLightUniformTag + ".quadratic", light->quadratic);
-			pointLightIndex++;
+		if (pointLightMode == POINT_LIGHTS_CLUSTERED)
+		{
+			lightClusters.Build(pointLightBuffer, view, radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT);
+			lightClusters.Upload();
+		}
+		else if (pointLightMode == POINT_LIGHTS_TREE)
+		{
+			lightTree.Build(pointLightBuffer);
+			lightTree.Upload();
 		}
-		// spotLight
-		TexturedObjectShader.setVec3("spotLight.position", camera.Position);
-		TexturedObjectShader.setVec3("spotLight.direction", camera.Front);
-		TexturedObjectShader.setVec3("spotLight.ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-		TexturedObjectShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		TexturedObjectShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		TexturedObjectShader.setFloat("spotLight.constant", 1.0f);
-		TexturedObjectShader.setFloat("spotLight.linear", 0.09f);
-		TexturedObjectShader.setFloat("spotLight.quadratic", 0.032f);
-		TexturedObjectShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		TexturedObjectShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
+		//Only a few draws, so their lists are always built and each draw applies its own whatever the mode
+		drawLights.BeginFrame(pointLightBuffer);
+		int planeDrawLights = drawLights.AddDraw(planeBoundsCentre, planeBoundsRadius);
+		vector<int> lampDrawLights;
+		for (vec3 lampPos : pointLightPositions)
+		{
+			lampDrawLights.push_back(drawLights.AddDraw(lampPos, lampBoundsRadius));
+		}
+		int forestDrawLights = drawLights.AddDraw(forestBoundsCentre, forestBoundsRadius);
+		int singleTreeDrawLights = drawLights.AddDraw(singleTreeBoundsCentre, singleTreeBoundsRadius);
+		int wallDrawLights = drawLights.AddDraw(wallBoundsCentre, wallBoundsRadius);
+		drawLights.Upload();
 
-		// ----------------------------
-		// Model lighting update
-		// ---------------------------
-		modelShader.Use();
-		modelShader.setVec3("dirLight.direction", -0.7f, -1.0f, 0.7f);
-		modelShader.setVec3("dirLight.ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-		modelShader.setVec3("dirLight.diffuse", dirLightColour.x, dirLightColour.y, dirLightColour.z);
-		modelShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// pointLights
-		pointLightIndex = 0;
-
-		for (PointLight* light : staticPointLights) {
-			pointLightUniformTag = ("pointLights[" + to_string(pointLightIndex) + "]");
-			modelShader.setVec3(pointLightUniformTag + ".position", light->position);
-			modelShader.setVec3(pointLightUniformTag + ".ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-			modelShader.setVec3(pointLightUniformTag + ".diffuse", lightColour);
-			modelShader.setVec3(pointLightUniformTag + ".specular", lightColour);
-			modelShader.setFloat(pointLightUniformTag + ".constant", light->constant);
-			modelShader.setFloat(pointLightUniformTag + ".linear", light->linear);
-			modelShader.setFloat(pointLightUniformTag + ".quadratic", light->quadratic);
-			pointLightIndex++;
+		//Nothing static moves yet so this is idle after startup, anything that does calls lampShadows.Invalidate
+		if (lampShadows.GetDirtyFaceCount() > 0)
+		{
+			lampShadows.BeginUpdate(shadowFaceBudget);
+			while (lampShadows.NextFace())
+			{
+				DrawShadowCasters(lampShadows.GetDepthShader(), treeModel, numberOfTrees, singleTreeModelMatrix, wallModel, wallModelMatrix);
+			}
+			lampShadows.EndUpdate();
 		}
+		//The lamps' shadows are in the bake when it's on, the lit shaders only shadow them as point lights
+		int shadowedLightCount = bakeStaticLamps ? 0 : (int)staticPointLights.size();
+		deferredRenderer.GetLightShader().Use();
+		deferredShadowedLightCount.Set(shadowedLightCount);
 
+		//Projected while last frame's bubbles were drawn
+		irradianceProbes.EndUpdate();
 
-		for (PointLight* light : dynamicPointLights) {
-			pointLightUniformTag = ("pointLights[" + to_string(pointLightIndex) + "]");
-			modelShader.setVec3(pointLightUniformTag + ".position", light->position);
-			modelShader.setVec3(pointLightUniformTag + ".ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-			modelShader.setVec3(pointLightUniformTag + ".diffuse", bubbleLightColour);
-			modelShader.setVec3(pointLightUniformTag + ".specular", bubbleLightColour);
-			modelShader.setFloat(pointLightUniformTag + ".constant", light->constant);
-			modelShader.setFloat(pointLightUniformTag + ".linear", light->linear);
-			modelShader.setFloat(pointLightUniformTag + ".quadratic", light->quadratic);
-			pointLightIndex++;
-		}
-		// spotLight
-		modelShader.setVec3("spotLight.position", camera.Position);
-		modelShader.setVec3("spotLight.direction", camera.Front);
-		modelShader.setVec3("spotLight.ambient", 0.1f, 0.1f, 0.1f);
-		modelShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		modelShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("spotLight.constant", 1.0f);
-		modelShader.setFloat("spotLight.linear", 0.09f);
-		modelShader.setFloat("spotLight.quadratic", 0.032f);
-		modelShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		modelShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+		//Baked lamps flicker in the shaders, this only turns them black while the lamps are in the point lights instead
+		vec3 staticLampDiffuse = bakeStaticLamps ? vec3(1.0f) : vec3(0.0f);
+		vec3 staticLampAmbient = bakeStaticLamps ? ambientLightColour : vec3(0.0f);
+
+		TexturedObjectShader.Use();
+		texturedObjectUniforms.pointLightMode.Set(pointLightMode);
+		texturedObjectUniforms.staticLampDiffuse.Set(staticLampDiffuse);
+		texturedObjectUniforms.staticLampAmbient.Set(staticLampAmbient);
+		texturedObjectUniforms.shadowedLightCount.Set(shadowedLightCount);
+		texturedObjectUniforms.useIrradianceProbes.Set(useIrradianceProbes);
+		modelShader.Use();
+		modelUniforms.pointLightMode.Set(pointLightMode);
+		modelUniforms.staticLampDiffuse.Set(staticLampDiffuse);
+		modelUniforms.staticLampAmbient.Set(staticLampAmbient);
+		modelUniforms.shadowedLightCount.Set(shadowedLightCount);
+		modelUniforms.useIrradianceProbes.Set(useIrradianceProbes);
 
 		// ----------------------------
 		// Sphere lighting update
 		// ---------------------------
 		sphereShader.Use();
-		sphereShader.setVec3("lightPos", globalLightPos);
-		sphereShader.setVec3("lightColour", vec3(1.0f, 1.0f, 1.0f));
-		sphereShader.setVec3("light.position", globalLightPos);
-		sphereShader.setVec3("light.ambient", ambientLightColour.x, ambientLightColour.y, ambientLightColour.z);
-		sphereShader.setVec3("light.diffuse", 0.35f, 0.35f, 0.35f);
-		sphereShader.setVec3("light.specular", 0.35f, 0.35f, 0.35f);
+		sphereUniforms.lightPos.Set(globalLightPos);
+		sphereUniforms.lightColour.Set(vec3(1.0f, 1.0f, 1.0f));
+		sphereUniforms.lightPosition.Set(globalLightPos);
+		sphereUniforms.lightAmbient.Set(ambientLightColour);
+		sphereUniforms.lightDiffuse.Set(vec3(0.35f, 0.35f, 0.35f));
+		sphereUniforms.lightSpecular.Set(vec3(0.35f, 0.35f, 0.35f));
+
+		sphereImpostorShader.Use();
+		sphereImpostorUniforms.lightPos.Set(globalLightPos);
+		sphereImpostorUniforms.lightPosition.Set(globalLightPos);
+		sphereImpostorUniforms.lightAmbient.Set(ambientLightColour);
+		sphereImpostorUniforms.lightDiffuse.Set(vec3(0.35f, 0.35f, 0.35f));
+		sphereImpostorUniforms.lightSpecular.Set(vec3(0.35f, 0.35f, 0.35f));
 
 
 #pragma endregion
@@ -873,6 +1394,12 @@ int main()
 
 
 
+		//--- Lit draws from here to the wall go to the G-buffer when deferred, the unlit ones after them are forward
+		if (pointLightMode == POINT_LIGHTS_DEFERRED)
+		{
+			deferredRenderer.BeginGeometryPass(backgroundColour);
+		}
+
 #pragma region Cube Rendering
 		//--- Render cubes		
 		for (unsigned int i = 0; i < 10; i++)
@@ -884,7 +1411,7 @@ int main()
 			model = rotate(model, radians(angle), vec3(1.0f, 0.3f, 0.5f));
 
 			TexturedObjectShader.Use();
-			TexturedObjectShader.setMat4("model", model);
+			texturedObjectUniforms.model.Set(model);
 
 
 			//sceneObjectDictionary["Cube Object"]->DrawMesh();
@@ -894,226 +1421,340 @@ int main()
 #pragma region Plane Rendering
 
 
-		mat4 model = mat4(1.0f);
-		model = translate(model, vec3(0.0f, 0.0f, -20.0f));
-		model = scale(model, vec3(90.0f, 1.0f, 50.0f));
-		model = rotate(model, radians(90.0f), vec3(1.0f, 0.0f, 0.0f));
+		mat4 model = planeModelMatrix;
 
 		TexturedObjectShader.Use();
 
-		TexturedObjectShader.setMat4("model", model);
-		TexturedObjectShader.setBool("useTexture", true);
-		TexturedObjectShader.setInt("texture1", 0);
+		texturedObjectUniforms.model.Set(model);
+		texturedObjectUniforms.useTexture.Set(true);
+		texturedObjectUniforms.texture1.Set(0);
+		texturedObjectUniforms.useStaticLightMap.Set(true);
+		drawLights.Apply(texturedObjectUniforms.drawLights, planeDrawLights);
 
 		sceneObjectDictionary["Plane Object"]->DrawMesh();
 #pragma endregion
 
 #pragma region Lamp Rendering
 
-		for (vec3 lampPos : pointLightPositions)
+		for (int lampIndex = 0; lampIndex < (int)lampDrawLights.size(); lampIndex++)
 		{
-			mat4 lampTransform = mat4(1.0f);
-			lampTransform = translate(lampTransform, vec3(lampPos.x, lampPos.y - 0.5f, lampPos.z));
-			lampTransform = scale(lampTransform, vec3(0.2f, 0.2f, 0.2f));
-
 			modelShader.Use();
-			modelShader.setMat4("model", lampTransform);
+			modelUniforms.model.Set(lampModelMatrices[lampIndex]);
+			drawLights.Apply(modelUniforms.drawLights, lampDrawLights[lampIndex]);
 
-			lampModel.Draw(modelShader, texNameToUnitNo["lampTexture"]);
+			//Mesh by mesh, each has its own baked vertices
+			for (size_t mesh = 0; mesh < lampModel.meshes.size(); mesh++)
+			{
+				staticLighting.Apply(modelUniforms.staticLightBake, lampBakes[lampIndex] + (int)mesh);
+				lampModel.meshes[mesh].Draw(modelShader, texNameToUnitNo["lampTexture"]);
+			}
 
 		}
 #pragma endregion
 
-#pragma region Projectile Spawning
-		// ------------------------
-		// Projectile spawning
-		// -------------------------
-		projectileSpawnTimer += deltaTime;
-		if (projectileSpawnTimer >= projectileSpawnCooldown && currentBubbles < maxBubbles)
-		{
-			ArcingProjectileObject* newProjectileObject = new ArcingProjectileObject();
-			//newProjectileObject->VAO = sceneObjectDictionary["Projectile Base"]->VAO;
-			//newProjectileObject->PrepareAndBindVBO(sceneObjectDictionary["Projectile Base"]->VBO, sizeof(cubeVertices) / (5 * sizeof(float)));
-
-			newProjectileObject->VAO = sceneObjectDictionary["Sphere Object"]->VAO;
-
-			newProjectileObject->PrepareAndBindVBO(sceneObjectDictionary["Sphere Object"]->VBO, sphereVerticesCount);
-			newProjectileObject->PrepareAndBindEBO(sceneObjectDictionary["Sphere Object"]->EBO, sphereIndicesCount);
-
-			GLenum error;
-			while ((error = glGetError()) != GL_NO_ERROR) {
-				cerr << "OpenGL error after VBO binding: " << error << endl;
-			}
-
-			//--- Spawn bounds
-			Point topLeft = { -40.0f, -0.1f, -40.0f };
-			Point bottomRight = { 40.0f, -0.1f, -10.0f };
-
-
-			float ySpawnValueMin = 1.5f;
-			float ySpawnValue = ySpawnValueMin + (2.0f - ySpawnValueMin) * dis(gen);
+#pragma region Tree Rendering
+		// --------------------
+		// Instanced rendering
+		// ---------------------
+		mat4 treeModelBase = mat4(1.0f);
 
-			float randomX = topLeft.x + (bottomRight.x - topLeft.x) * dis(gen);
-			float randomY = ySpawnValue;
-			float randomZ = topLeft.z + (bottomRight.z - topLeft.z) * dis(gen);
+		modelShader.Use();
+		modelUniforms.model.Set(treeModelBase);
+		modelUniforms.useInstancing.Set(true);
+		drawLights.Apply(modelUniforms.drawLights, forestDrawLights);
+		staticLighting.Apply(modelUniforms.staticLightBake, forestBake);
 
-			vec3 spawnPosition = vec3(randomX, randomY, randomZ);
+		glBindVertexArray(treeModel.meshes[0].VAO);
 
-			//--- Launch angle
-			//Angle when looking down the y axis
-			float azimuth = dis(gen) * 2 * PI;
+		GLuint currentTexture;
+		glActiveTexture(GL_TEXTURE0 + texNameToUnitNo["treeTexture"]);
+		glBindTexture(GL_TEXTURE_2D, treeModel.textures_loaded[0].id);
+		modelUniforms.textureDiffuse1.Set(texNameToUnitNo["treeTexture"]);
 
-			//Phi is the vertical angle from the horizontal plane
-			float minPhi = PI / 6;  // 30 degrees in radians
-			float maxPhi = 4 * PI / 9;  // 80 degrees in radians
+		glDrawElementsInstanced(GL_TRIANGLES, treeModel.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, numberOfTrees);
+		glBindVertexArray(0);
 
-			float phi = minPhi + (maxPhi - minPhi) * dis(gen);
 
-			float x = sin(phi) * cos(azimuth);
-			float y = cos(phi);
-			float z = sin(phi) * sin(azimuth);
+		// ------------------------
+		// Old multi tree rendering
+		// -----------------------
+		/*
+		for (unsigned int i = 0; i < numberOfTrees; i++)
+		{
+			// calculate the model matrix for each object and pass it to shader before drawing
+			mat4 model = mat4(1.0f); // make sure to initialize matrix to identity matrix first
 
-			float initVelMin = 1.8f;
-			float velocityMulitplier = initVelMin + (2.2f - initVelMin) * dis(gen);
-			vec3 spawnVelocity = normalize(vec3(x, y, z));
 
-			spawnVelocity = spawnVelocity * velocityMulitplier;
 
-			//--- Random speed multiplaier
-			float speedMin = 0.3f;
-			float movespeedMultiplier = speedMin + (0.7f - speedMin) * dis(gen);
+			model = translate(model, randomTreePositions[i]);
+			model = rotate(model, radians(randomTreeRotations[i]), vec3(0.0f, 1.0f, 0.0f));
 
-			//--- Random gravity multiplier
-			float gravityMultiMin = 0.0f;
-			float gravityMultiplier = gravityMultiMin + (0.04f - gravityMultiMin) * dis(gen);
 
-			newProjectileObject->Launch(vec3(spawnVelocity), vec3(spawnPosition), currentFrame, gravityMultiplier, movespeedMultiplier);
 
-			projectileObjects.push_back(newProjectileObject);
+			//TexturedObjectShader.setMat4("model", model);
 
+			//TexturedObjectShader.setVec3("lightPos", lightPos);
+			//TexturedObjectShader.setVec3("viewPos", camera.Position);
+			//TexturedObjectShader.setVec3("light.position", camera.Position);
+			//TexturedObjectShader.setVec3("light.direction", camera.Front);
+			//TexturedObjectShader.setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
+			//TexturedObjectShader.setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
 
-			//--- Bubble sound
-			ISound* sound = audioEngine->play3D("Media/Audio/bathtub-ambience-27873.mp3", vec3df(spawnPosition.x, spawnPosition.y, spawnPosition.z), true, false, true);
-			if (!sound) {
-				std::cerr << "Failed to load sound file for bubble" << std::endl;
+			//modelShader.setMat4("model", model);
+			//modelShader.setMat4("projection", projection);
+			//modelShader.setMat4("view", view);
+			//treeModel.Draw(modelShader);
 
-			}
-			else {
-				sound->setVolume(2.5f);
 
-				sound->setMinDistance(5.0f);
+			modelShader.Use();
 
+			modelShader.setMat4("model", model);
+			modelShader.setMat4("projection", projection);
+			modelShader.setMat4("view", view);
+			modelShader.setBool("useInstancing", false);
 
-				bubbleSounds[newProjectileObject] = sound;
+			//treeModel.Draw(modelShader, texNameToUnitNo["treeTexture"]);
+			//sceneObjectDictionary["Cube Object"]->DrawMesh();
+			GLenum error;
+			while ((error = glGetError()) != GL_NO_ERROR) {
+				cerr << "OpenGL error post tree render: " << error << endl;
 			}
+		}*/
 
-			//--- Bubble lighting
-			PointLight* newLight = new PointLight(
-				newProjectileObject->currentPosition,
-				1.0f,
-				0.09f,
-				0.032f,
-				ambientLightColour,
-				lightColour,
-				lightColour
-			);
-
-			dynamicBubbleLights[newProjectileObject] = newLight;
-			dynamicPointLights.push_back(newLight);
-
-			currentBubbles++;
 
-			//Random spawn cooldown
-			float cooldownMin = 2.0f;
-			projectileSpawnCooldown = cooldownMin + (4.0f - cooldownMin) * dis(gen);
+		// ----------------------
+		// Single tree render
+		// ----------------------
+		modelShader.Use();
+		modelUniforms.model.Set(singleTreeModelMatrix);
+		modelUniforms.useInstancing.Set(false);
+		drawLights.Apply(modelUniforms.drawLights, singleTreeDrawLights);
 
-			projectileSpawnTimer = 0.0f;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&currentTexture);
+		for (size_t mesh = 0; mesh < treeModel.meshes.size(); mesh++)
+		{
+			staticLighting.Apply(modelUniforms.staticLightBake, singleTreeBake + (int)mesh);
+			treeModel.meshes[mesh].Draw(modelShader, texNameToUnitNo["treeTexture"]);
 		}
 #pragma endregion
 
 
 
+#pragma region Wall Rendering
+		modelShader.Use();
+		modelUniforms.model.Set(wallModelMatrix);
+		modelUniforms.useInstancing.Set(false);
+		drawLights.Apply(modelUniforms.drawLights, wallDrawLights);
 
-#pragma region Projectile Update
-
-		for (size_t i = 0; i < projectileObjects.size();) {
-			ArcingProjectileObject* projectileObject = projectileObjects[i];
-			if (projectileObject != NULL)
-			{
-				projectileObject->UpdatePosition(deltaTime);
-
-				if (projectileObject->ShouldDestroy()) {
-
-					bubbleSounds[projectileObject]->drop();
-					bubbleSounds.erase(projectileObject);
-					PointLight* objectLight = dynamicBubbleLights[projectileObject];
-					dynamicPointLights.erase(remove(dynamicPointLights.begin(), dynamicPointLights.end(), objectLight), dynamicPointLights.end());
-					delete objectLight;
-
-					dynamicBubbleLights.erase(projectileObject);
 
-					TexturedObjectShader.Use();
-					int numberOfPointLights = dynamicPointLights.size();
-					TexturedObjectShader.setInt("dynamicPointLights", numberOfPointLights);
-					delete projectileObject;
-					projectileObjects.erase(projectileObjects.begin() + i);
-					currentBubbles--;
+		for (size_t mesh = 0; mesh < wallModel.meshes.size(); mesh++)
+		{
+			staticLighting.Apply(modelUniforms.staticLightBake, wallBake + (int)mesh);
+			wallModel.meshes[mesh].Draw(modelShader, texNameToUnitNo["wallTexture"]);
+		}
 
-					modelShader.Use();					
-					modelShader.setInt("dynamicPointLights", numberOfPointLights);
+#pragma endregion
 
+		if (pointLightMode == POINT_LIGHTS_DEFERRED)
+		{
+			deferredRenderer.LightPass(pointLightBuffer);
+			deferredRenderer.Resolve();
+		}
 
+#pragma region Projectile Spawning
+		// ------------------------
+		// Bubble sounds and lights
+		// -------------------------
+		// Spawning and popping happen on the simulation thread, which hands over the bubbles that came and went
+		// since the last read. Only those take or give back a pooled sound and light, the rest are left alone.
+		if (bubbleMode != BUBBLES_CPU_THREAD)
+		{
+			//Another mode's bubbles carry nothing, everything the CPU bubbles held goes back once
+			bubbleChanges.clear();
+			if (bubblePoolsTrackSimulation)
+			{
+				for (ProjectileHandle owner : bubbleOwners)
+				{
+					bubbleChanges.push_back({ owner, false });
 				}
-				else {
-					mat4 projectileModel = mat4(1.0f);
-					projectileModel = translate(projectileModel, projectileObject->initialPosition + (projectileObject->currentPosition - projectileObject->initialPosition));
-
-
-
-					sphereShader.Use();
+				bubblePoolsTrackSimulation = false;
+			}
+		}
+		else if (!bubblePoolsTrackSimulation)
+		{
+			//Back from another mode, every live bubble is new to the pools
+			bubbleChanges.clear();
+			for (ProjectileHandle handle : bubbleHandles)
+			{
+				bubbleChanges.push_back({ handle, true });
+			}
+			bubblePoolsTrackSimulation = true;
+		}
 
+		//--- In the order they happened, so a popped bubble lets go of its slot before a new bubble takes it
+		for (const BubbleChange& change : bubbleChanges)
+		{
+			ProjectileHandle handle = change.handle;
 
-					sphereShader.setMat4("model", projectileModel);
-					sphereShader.setFloat("time", currentFrame);
-					sphereShader.setFloat("displacementScale", 0.4f);
-					sphereShader.setInt("firstNoiseTexture", texNameToUnitNo["firstNoiseTexture"]);
-					sphereShader.setInt("secondNoiseTexture", texNameToUnitNo["secondNoiseTexture"]);
-					
-					
-					
+			//New bubble, the simulation never has more bubbles than the pools hold
+			if (change.spawned)
+			{
+				if (dynamicPointLights.IsFull() || bubbleSounds.IsFull())
+				{
+					continue;
+				}
 
+				//Left paused, significance below decides whether it plays
+				ISound* sound = *bubbleSounds.Acquire();
+				if (sound != NULL)
+				{
+					sound->setPlayPosition(0);
+				}
 
+				dynamicPointLights.Acquire();
+				if (handle.slot >= bubbleSlotToPool.size())
+				{
+					bubbleSlotToPool.resize(handle.slot + 1, -1);
+				}
+				bubbleSlotToPool[handle.slot] = (int)bubbleOwners.size();
+				bubbleOwners.push_back(handle);
+				continue;
+			}
 
+			//Popped bubble
+			int p = FindBubblePoolIndex(handle);
+			if (p == -1)
+			{
+				continue;
+			}
 
-					bubbleSounds[projectileObject]->setPosition(vec3df(projectileObject->currentPosition.x, projectileObject->currentPosition.y, projectileObject->currentPosition.z));
+			if (bubbleSounds[p] != NULL)
+			{
+				bubbleSounds[p]->setIsPaused(true);
+			}
+			bubbleSounds.RemoveAt(p);
+			dynamicPointLights.RemoveAt(p);
+
+			//The last entry was swapped into the hole in both pools, the owners follow
+			bubbleSlotToPool[handle.slot] = -1;
+			bubbleOwners[p] = bubbleOwners.back();
+			bubbleOwners.pop_back();
+			if ((size_t)p < bubbleOwners.size())
+			{
+				bubbleSlotToPool[bubbleOwners[p].slot] = p;
+			}
+		}
+#pragma endregion
 
-					dynamicBubbleLights[projectileObject]->position = projectileObject->currentPosition;
 
-					projectileObject->DrawMesh();
 
 
-					TexturedObjectShader.Use();
-					int numberOfPointLights = dynamicPointLights.size();
-					TexturedObjectShader.setInt("dynamicPointLights", numberOfPointLights);
+#pragma region Projectile Update
+		bubbleRenderer.BeginFrame();
 
-					modelShader.Use();					
-					modelShader.setInt("dynamicPointLights", numberOfPointLights);
-					GLenum error;
-					while ((error = glGetError()) != GL_NO_ERROR) {
-						cerr << "OpenGL error post projectile render: " << error << endl;
+		// ------------------------
+		// Significance
+		// ------------------------
+		// Scored by size on screen, the impostor threshold is a bubble's size at bubbleImpostorDistance
+		float projectionScale = SCR_HEIGHT * 0.5f / tan(radians(camera.Zoom) * 0.5f);
+		bubbleSignificance.SetViewpoint(camera.Position, camera.Front, projectionScale);
+		bubbleSignificance.impostorScore = useBubbleImpostors ? bubbleSignificance.ScreenRadius(bubbleImpostorRadius, bubbleImpostorDistance) : 0.0f;
+		bubbleSignificance.maxLights = useIrradianceProbes ? maxBubbleLightsWithProbes : maxBubbleLights;
+		bubbleSignificance.Evaluate(bubblePositions, bubbleImpostorRadius);
+		bubbleSimulation.SetViewpoint(camera.Position, camera.Front, projectionScale);
+
+		litBubbleLights.clear();
+		for (size_t i = 0; i < bubbleHandles.size(); i++) {
+			vec3 projectilePosition = bubblePositions[i];
+			const Significance& significance = bubbleSignificance.Get(i);
+
+			int poolIndex = FindBubblePoolIndex(bubbleHandles[i]);
+			if (poolIndex != -1)
+			{
+				//Outside the voice budget the sound is paused where it is and picks up from there once it's back in
+				ISound* sound = bubbleSounds[poolIndex];
+				if (sound != NULL)
+				{
+					if (significance.voice)
+					{
+						sound->setPosition(vec3df(projectilePosition.x, projectilePosition.y, projectilePosition.z));
 					}
+					if (sound->getIsPaused() == significance.voice)
+					{
+						sound->setIsPaused(!significance.voice);
+					}
+				}
 
-					++i;
+				dynamicPointLights[poolIndex].position = projectilePosition;
+				if (significance.light)
+				{
+					litBubbleLights.push_back(dynamicPointLights[poolIndex]);
+				}
+				else if (useIrradianceProbes)
+				{
+					PointLight probeLight = dynamicPointLights[poolIndex];
+					probeLight.diffuse = bubbleLightColour;
+					//Keyed by the simulation slot, pool indices move when another bubble is removed
+					irradianceProbes.SetLight((int)bubbleHandles[i].slot, probeLight);
 				}
 			}
 
+			//--- Small on screen, swap to the impostor quad, the sphere is intersected per pixel instead
+			bool asImpostor = significance.impostor;
 
+			//Slot is stable for the bubble's life, golden ratio spacing keeps neighbouring slots' phases apart
+			float phase = fract(bubbleHandles[i].slot * 0.618034f);
+			bubbleRenderer.AddBubble(projectilePosition, phase, asImpostor);
 		}
-#pragma endregion
 
+		//Bubbles that weren't set this frame leave the probes, the workers project them while the bubbles draw
+		irradianceProbes.BeginUpdate();
+
+		//--- All bubbles in one instanced draw per shader
+		sphereShader.Use();
+		sphereUniforms.useInstancing.Set(true);
+		sphereUniforms.displacementScale.Set(bubbleDisplacementScale);
+		sphereUniforms.firstNoiseTexture.Set(texNameToUnitNo["firstNoiseTexture"]);
+		sphereUniforms.secondNoiseTexture.Set(texNameToUnitNo["secondNoiseTexture"]);
 
+		float splitDistance = useBubbleImpostors ? bubbleImpostorDistance : 0.0f;
+		if (bubbleMode == BUBBLES_GPU_TRANSFORM_FEEDBACK)
+		{
+			//Advance on the GPU and draw straight from the result, nothing per bubble happens on the CPU
+			gpuBubbles.Update(deltaTime);
+			bubbleRenderer.DrawFromBuffer(sphereShader, sphereImpostorShader, gpuBubbles.GetRenderBuffer(), GpuBubbleSimulation::recordStride,
+				gpuBubbles.GetBubbleCount(), splitDistance);
+		}
+		else if (bubbleMode == BUBBLES_ANALYTIC_SHADER)
+		{
+			//Only launches and retirements happen here, the shaders place every live bubble from time
+			analyticBubbles.Update(currentFrame);
+
+			sphereUniforms.analyticTrajectory.Set(true);
+			sphereUniforms.gravity.Set(analyticBubbles.gravity);
+			sphereImpostorShader.Use();
+			sphereImpostorUniforms.analyticTrajectory.Set(true);
+			sphereImpostorUniforms.gravity.Set(analyticBubbles.gravity);
+
+			bubbleRenderer.DrawFromBuffer(sphereShader, sphereImpostorShader, analyticBubbles.GetInstanceBuffer(), AnalyticBubbleSystem::recordStride,
+				analyticBubbles.GetInstanceCount(), splitDistance, 3);
+
+			sphereShader.Use();
+			sphereUniforms.analyticTrajectory.Set(false);
+			sphereImpostorShader.Use();
+			sphereImpostorUniforms.analyticTrajectory.Set(false);
+		}
+		else {
+			bubbleRenderer.Draw(sphereShader, sphereImpostorShader);
+		}
 
 		GLenum error;
+		while ((error = glGetError()) != GL_NO_ERROR) {
+			cerr << "OpenGL error post projectile render: " << error << endl;
+		}
+#pragma endregion
+
+
 
 
 #pragma region Proc terrain Rendering
@@ -1128,7 +1769,7 @@ int main()
 		//Elevation to look upon terrain
 		terrainModel = scale(terrainModel, vec3(6.0f, 1.3f, 6.0f));
 		ProceduralObjectShader.Use();
-		ProceduralObjectShader.setMat4("model", terrainModel);
+		terrainModelUniform.Set(terrainModel);
 
 
 		sceneObjectDictionary["Procedural Terrain"]->DrawMesh();
@@ -1142,11 +1783,11 @@ int main()
 
 		sphereShader.Use();
 
-		sphereShader.setMat4("model", sphereModel);
-		sphereShader.setFloat("time", currentFrame);
-		sphereShader.setFloat("displacementScale", 0.4f);
-		sphereShader.setInt("firstNoiseTexture", texNameToUnitNo["firstNoiseTexture"]);
-		sphereShader.setInt("secondNoiseTexture", texNameToUnitNo["secondNoiseTexture"]);
+		sphereUniforms.model.Set(sphereModel);
+		sphereUniforms.useInstancing.Set(false);
+		sphereUniforms.displacementScale.Set(bubbleDisplacementScale);
+		sphereUniforms.firstNoiseTexture.Set(texNameToUnitNo["firstNoiseTexture"]);
+		sphereUniforms.secondNoiseTexture.Set(texNameToUnitNo["secondNoiseTexture"]);
 
 
 
@@ -1155,103 +1796,6 @@ int main()
 
 
 
-#pragma region Tree Rendering
-		// --------------------
-		// Instanced rendering
-		// ---------------------
-		mat4 treeModelBase = mat4(1.0f);
-
-		modelShader.Use();
-		modelShader.setMat4("model", treeModelBase);
-		modelShader.setBool("useInstancing", true);
-
-		glBindVertexArray(treeModel.meshes[0].VAO);
-
-		GLuint currentTexture;
-		glActiveTexture(GL_TEXTURE0 + texNameToUnitNo["treeTexture"]);
-		glBindTexture(GL_TEXTURE_2D, treeModel.textures_loaded[0].id);
-		modelShader.setInt(("texture_diffuse1"), texNameToUnitNo["treeTexture"]);
-
-		glDrawElementsInstanced(GL_TRIANGLES, treeModel.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, numberOfTrees);
-		glBindVertexArray(0);
-
-
-		// ------------------------
-		// Old multi tree rendering
-		// -----------------------
-		/*
-		for (unsigned int i = 0; i < numberOfTrees; i++)
-		{
-			// calculate the model matrix for each object and pass it to shader before drawing
-			mat4 model = mat4(1.0f); // make sure to initialize matrix to identity matrix first
-
-
-
-			model = translate(model, randomTreePositions[i]);
-			model = rotate(model, radians(randomTreeRotations[i]), vec3(0.0f, 1.0f, 0.0f));
-
-
-
-			//TexturedObjectShader.setMat4("model", model);
-
-			//TexturedObjectShader.setVec3("lightPos", lightPos);
-			//TexturedObjectShader.setVec3("viewPos", camera.Position);
-			//TexturedObjectShader.setVec3("light.position", camera.Position);
-			//TexturedObjectShader.setVec3("light.direction", camera.Front);
-			//TexturedObjectShader.setFloat("light.cutOff", glm::cos(glm::radians(12.5f)));
-			//TexturedObjectShader.setFloat("light.outerCutOff", glm::cos(glm::radians(17.5f)));
-
-			//modelShader.setMat4("model", model);
-			//modelShader.setMat4("projection", projection);
-			//modelShader.setMat4("view", view);
-			//treeModel.Draw(modelShader);
-
-
-			modelShader.Use();
-
-			modelShader.setMat4("model", model);
-			modelShader.setMat4("projection", projection);
-			modelShader.setMat4("view", view);
-			modelShader.setBool("useInstancing", false);
-
-			//treeModel.Draw(modelShader, texNameToUnitNo["treeTexture"]);
-			//sceneObjectDictionary["Cube Object"]->DrawMesh();
-			GLenum error;
-			while ((error = glGetError()) != GL_NO_ERROR) {
-				cerr << "OpenGL error post tree render: " << error << endl;
-			}
-		}*/
-
-
-		// ----------------------
-		// Single tree render
-		// ----------------------
-		modelShader.Use();
-		mat4 modelLocation = mat4(1.0f);
-		modelLocation = scale(modelLocation, vec3(0.8f, 0.8f, 0.8f));
-		modelShader.setMat4("model", modelLocation);
-		modelShader.setBool("useInstancing", false);
-
-		glGetIntegerv(GL_TEXTURE_BINDING_2D, (GLint*)&currentTexture);
-		treeModel.Draw(modelShader, texNameToUnitNo["treeTexture"]);
-#pragma endregion
-
-
-
-#pragma region Wall Rendering
-		modelShader.Use();
-		modelLocation = mat4(1.0f);
-		modelLocation = scale(modelLocation, vec3(0.8f, 0.8f, 0.8f));
-		modelLocation = translate(modelLocation, vec3(2.0f, 0.0f, 0.0f));
-		modelLocation = rotate(modelLocation, radians(-90.0f), vec3(1.0f, 0.0f, 0.0f));
-		modelLocation = rotate(modelLocation, radians(-90.0f), vec3(0.0f, 0.0f, 1.0f));
-		modelShader.setMat4("model", modelLocation);
-		modelShader.setBool("useInstancing", false);
-
-
-		wallModel.Draw(modelShader, texNameToUnitNo["wallTexture"]);
-
-#pragma endregion
 
 
 		//--- Swap buffers to render to screen, poll IO events
@@ -1259,6 +1803,8 @@ int main()
 		glfwPollEvents();
 	}
 
+	bubbleSimulation.Stop();
+
 	for (auto& pair : sceneObjectDictionary)
 	{
 		CustomSceneObject* object = pair.second;
@@ -1268,16 +1814,37 @@ int main()
 		}
 	}
 
-	for (ArcingProjectileObject* projectile : projectileObjects)
+	//Every pooled voice, including the paused ones not in use
+	for (size_t i = 0; i < bubbleSounds.Capacity(); i++)
 	{
-		bubbleSounds[projectile]->drop();
-		bubbleSounds.erase(projectile);
-
-		projectile->CleanUp();
+		ISound* sound = bubbleSounds.Data()[i];
+		if (sound != NULL)
+		{
+			sound->stop();
+			sound->drop();
+		}
 	}
 
+	bubbleRenderer.CleanUp();
+	gpuBubbles.CleanUp();
+	analyticBubbles.CleanUp();
+	bubbleWind.CleanUp();
+	frameUniforms.CleanUp();
+	pointLightBuffer.CleanUp();
+	lightClusters.CleanUp();
+	drawLights.CleanUp();
+	deferredRenderer.CleanUp();
+	lightTree.CleanUp();
+	staticLighting.CleanUp();
+	lampShadows.CleanUp();
+	irradianceProbes.CleanUp();
+
 	sceneObjectDictionary.clear();
-	projectileObjects.clear();
+	bubbleOwners.clear();
+	bubbleSlotToPool.clear();
+	bubbleSounds.Clear();
+	dynamicPointLights.Clear();
+	litBubbleLights.clear();
 
 	audioEngine->drop();
 
@@ -1326,6 +1893,81 @@ void processInput(GLFWwindow* window)
 			spacePressed = false;
 		}			
 	}
+	if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+		if (!impostorKeyPressed)
+		{
+			impostorKeyPressed = true;
+			useBubbleImpostors = !useBubbleImpostors;
+			cout << "Bubble impostors " << (useBubbleImpostors ? "enabled" : "disabled") << endl;
+		}
+	}
+	else {
+		impostorKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+		if (!bubbleModeKeyPressed)
+		{
+			bubbleModeKeyPressed = true;
+			bubbleMode = (BubbleMode)((bubbleMode + 1) % BUBBLE_MODE_COUNT);
+
+			const char* bubbleModeNames[] = { "CPU simulation thread", "GPU transform feedback", "analytic shader trajectories" };
+			cout << "Bubble mode: " << bubbleModeNames[bubbleMode] << endl;
+		}
+	}
+	else {
+		bubbleModeKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+		if (!pointLightModeKeyPressed)
+		{
+			pointLightModeKeyPressed = true;
+			pointLightMode = (PointLightMode)((pointLightMode + 1) % POINT_LIGHT_MODE_COUNT);
+
+			const char* pointLightModeNames[] = { "every light", "clustered", "per draw", "deferred", "light tree" };
+			cout << "Point lights: " << pointLightModeNames[pointLightMode] << endl;
+		}
+	}
+	else {
+		pointLightModeKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+		if (!bakeStaticLampsKeyPressed)
+		{
+			bakeStaticLampsKeyPressed = true;
+			bakeStaticLamps = !bakeStaticLamps;
+			cout << "Lamps: " << (bakeStaticLamps ? "baked" : "point lights") << endl;
+		}
+	}
+	else {
+		bakeStaticLampsKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+		if (!useIrradianceProbesKeyPressed)
+		{
+			useIrradianceProbesKeyPressed = true;
+			useIrradianceProbes = !useIrradianceProbes;
+			cout << "Irradiance probes: " << (useIrradianceProbes ? "on" : "off") << endl;
+		}
+	}
+	else {
+		useIrradianceProbesKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS) {
+		if (!uniformCountsKeyPressed)
+		{
+			uniformCountsKeyPressed = true;
+			UniformUploadCounts counts = Shader::GetUploadCounts();
+			cout << "Uniform uploads last frame: " << counts.issued << " sent, " << counts.skipped << " skipped" << endl;
+		}
+	}
+	else {
+		uniformCountsKeyPressed = false;
+	}
 }
 
 //--- Callback method when window is resized
@@ -1334,6 +1976,13 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	// make sure the viewport matches the new window dimensions; note that width and 
 	// height will be significantly larger than specified on retina displays.
 	glViewport(0, 0, width, height);
+
+	//Minimised, nothing is drawn and a zero size would divide by zero, so the last real size is kept
+	if (width > 0 && height > 0)
+	{
+		framebufferSize = ivec2(width, height);
+		framebufferResized = true;
+	}
 }
 
 
@@ -1527,14 +2176,14 @@ void CreateProceduralTerrain(float* terrainVertices, int terrainVerticesCount) {
 
 	terrainNoise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 	terrainNoise.SetFrequency(0.05f);
-	int terrainSeed = rand() % 100;
+	int terrainSeed = terrainRandom.NextUInt() % 100;
 	terrainNoise.SetSeed(terrainSeed);
 
 	//Biome generation
 	FastNoiseLite biomeNoise;
 	biomeNoise.SetNoiseType(FastNoiseLite::NoiseType_Cellular);
 	biomeNoise.SetFrequency(0.05f);
-	int biomeSeed = rand() % 100;
+	int biomeSeed = terrainRandom.NextUInt() % 100;
 	biomeNoise.SetSeed(biomeSeed);
 
 	//--- Height variation
@@ -1582,6 +2231,23 @@ void CreateProceduralTerrain(float* terrainVertices, int terrainVerticesCount) {
 
 }
 
+/// <summary>
+/// Pool entry holding the bubble's sound and light, -1 when it has none. A reused slot's older bubble doesn't count.
+/// </summary>
+int FindBubblePoolIndex(ProjectileHandle handle) {
+	if (handle.slot >= bubbleSlotToPool.size())
+	{
+		return -1;
+	}
+
+	int poolIndex = bubbleSlotToPool[handle.slot];
+	if (poolIndex == -1 || bubbleOwners[poolIndex].generation != handle.generation)
+	{
+		return -1;
+	}
+	return poolIndex;
+}
+
 void CreateSphereObject(float sphereVertices[latitudeSteps][longitudeSteps][11], unsigned int sphereIndices[(longitudeSteps - 1) * (latitudeSteps - 1) * 6]) {
 
 
@@ -1685,7 +2351,73 @@ void CreateSphereObject(float sphereVertices[latitudeSteps][longitudeSteps][11],
 
 }
 
+/// <summary>
+/// Draws everything that casts lamp shadows into the current shadow face. The lamps would only shadow their own light and
+/// nothing is under the floor for it to shadow, so neither is drawn.
+/// </summary>
+void DrawShadowCasters(Shader& depthShader, const Model& treeModel, int numberOfTrees, const mat4& singleTreeModelMatrix, const Model& wallModel, const mat4& wallModelMatrix) {
+	depthShader.setBool("useInstancing", true);
+	glBindVertexArray(treeModel.meshes[0].VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, treeModel.meshes[0].indices.size(), GL_UNSIGNED_INT, 0, numberOfTrees);
+
+	depthShader.setBool("useInstancing", false);
+	depthShader.setMat4("model", singleTreeModelMatrix);
+	for (const Mesh& mesh : treeModel.meshes)
+	{
+		glBindVertexArray(mesh.VAO);
+		glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+	}
+
+	depthShader.setMat4("model", wallModelMatrix);
+	for (const Mesh& mesh : wallModel.meshes)
+	{
+		glBindVertexArray(mesh.VAO);
+		glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
+	}
+	glBindVertexArray(0);
+}
+
+/// <summary>
+/// Looks up the lit shaders' per frame uniforms once, the plane's and the models' programs share them
+/// </summary>
+LitShaderUniforms FindLitShaderUniforms(const Shader& shader) {
+	LitShaderUniforms uniforms;
+	uniforms.model = shader.uniform("model");
+	uniforms.useInstancing = shader.uniform("useInstancing");
+	uniforms.useTexture = shader.uniform("useTexture");
+	uniforms.texture1 = shader.uniform("texture1");
+	uniforms.textureDiffuse1 = shader.uniform("texture_diffuse1");
+	uniforms.useStaticLightMap = shader.uniform("useStaticLightMap");
+	uniforms.pointLightMode = shader.uniform("pointLightMode");
+	uniforms.staticLampDiffuse = shader.uniform("staticLampDiffuse");
+	uniforms.staticLampAmbient = shader.uniform("staticLampAmbient");
+	uniforms.shadowedLightCount = shader.uniform("shadowedLightCount");
+	uniforms.useIrradianceProbes = shader.uniform("useIrradianceProbes");
+	uniforms.drawLights = shader.uniform("drawLights");
+	uniforms.staticLightBake = shader.uniform("staticLightBake");
+	return uniforms;
+}
 
+/// <summary>
+/// Looks up the bubble shaders' per frame uniforms once, for the mesh or the impostor program
+/// </summary>
+BubbleShaderUniforms FindBubbleShaderUniforms(const Shader& shader) {
+	BubbleShaderUniforms uniforms;
+	uniforms.model = shader.uniform("model");
+	uniforms.useInstancing = shader.uniform("useInstancing");
+	uniforms.displacementScale = shader.uniform("displacementScale");
+	uniforms.firstNoiseTexture = shader.uniform("firstNoiseTexture");
+	uniforms.secondNoiseTexture = shader.uniform("secondNoiseTexture");
+	uniforms.analyticTrajectory = shader.uniform("analyticTrajectory");
+	uniforms.gravity = shader.uniform("gravity");
+	uniforms.lightPos = shader.uniform("lightPos");
+	uniforms.lightColour = shader.uniform("lightColour");
+	uniforms.lightPosition = shader.uniform("light.position");
+	uniforms.lightAmbient = shader.uniform("light.ambient");
+	uniforms.lightDiffuse = shader.uniform("light.diffuse");
+	uniforms.lightSpecular = shader.uniform("light.specular");
+	return uniforms;
+}
 
 
 
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/// <summary>
+/// Fixed capacity pool of T held in one contiguous block. Live objects are always packed at the front,
+/// index 0 to Size(), so they can be looped over directly.
+/// Acquire hands out the next free object, RemoveAt swaps the last live object into the hole. Both are O(1)
+/// and neither allocates, all capacity is created up front by Allocate.
+/// Removed objects are swapped rather than destroyed, so anything they own (a paused sound for instance) is kept
+/// for the next Acquire to reuse.
+/// </summary>
+template <typename T>
+class ObjectPool
+{
+public:
+	ObjectPool() {};
+
+	/// <summary>
+	/// Creates every object the pool will ever hold as a copy of the prototype. Any existing objects are discarded.
+	/// </summary>
+	void Allocate(size_t capacity, const T& prototype)
+	{
+		items.assign(capacity, prototype);
+		count = 0;
+	}
+
+	/// <summary>
+	/// Next free object, moved into the live range. Returns NULL when the pool is full.
+	/// </summary>
+	T* Acquire()
+	{
+		if (count == items.size())
+		{
+			return NULL;
+		}
+		return &items[count++];
+	}
+
+	/// <summary>
+	/// Swap and pop. The last live object moves into index, the removed one moves to the start of the free range.
+	/// </summary>
+	void RemoveAt(size_t index)
+	{
+		count--;
+		if (index != count)
+		{
+			swap(items[index], items[count]);
+		}
+	}
+
+	void Clear()
+	{
+		count = 0;
+	}
+
+	T& operator[](size_t index) { return items[index]; }
+	const T& operator[](size_t index) const { return items[index]; }
+
+	//--- Range for loops only visit live objects
+	T* begin() { return items.data(); }
+	T* end() { return items.data() + count; }
+
+	/// <summary>
+	/// Whole block, live and free, for setting up or tearing down every object
+	/// </summary>
+	T* Data() { return items.data(); }
+
+	size_t Size() const { return count; }
+	size_t Capacity() const { return items.size(); }
+	bool IsFull() const { return count == items.size(); }
+
+private:
+	vector<T> items;
+	size_t count = 0;
+};
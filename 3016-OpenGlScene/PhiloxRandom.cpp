@@ -0,0 +1,125 @@
+#include "PhiloxRandom.h"
+
+//--- Philox4x32 constants, Salmon et al. "Parallel Random Numbers: As Easy as 1, 2, 3"
+const uint32_t philoxMultiplier0 = 0xD2511F53;
+const uint32_t philoxMultiplier1 = 0xCD9E8D57;
+const uint32_t philoxWeyl0 = 0x9E3779B9;
+const uint32_t philoxWeyl1 = 0xBB67AE85;
+const int philoxRounds = 10;
+
+//24 random bits mapped to [0, 1), the most a float mantissa can hold evenly
+const float uintToUnitFloat = 1.0f / 16777216.0f;
+
+PhiloxRandom::PhiloxRandom(uint64_t seed, uint64_t stream) {
+	Seed(seed, stream);
+}
+
+/// <summary>
+/// Restarts the sequence. The stream picks an independent sequence for the same seed.
+/// </summary>
+void PhiloxRandom::Seed(uint64_t seed, uint64_t stream) {
+	key[0] = (uint32_t)seed;
+	key[1] = (uint32_t)(seed >> 32);
+	this->stream[0] = (uint32_t)stream;
+	this->stream[1] = (uint32_t)(stream >> 32);
+	blockIndex = 0;
+	bufferedRemaining = 0;
+}
+
+/// <summary>
+/// Ten rounds of multiply and mix over a 128 bit counter made of the block index and the stream
+/// </summary>
+void PhiloxRandom::GenerateBlock(uint64_t index, uint32_t output[4]) const {
+	uint32_t counter0 = (uint32_t)index;
+	uint32_t counter1 = (uint32_t)(index >> 32);
+	uint32_t counter2 = stream[0];
+	uint32_t counter3 = stream[1];
+	uint32_t key0 = key[0];
+	uint32_t key1 = key[1];
+
+	for (int round = 0; round < philoxRounds; round++)
+	{
+		uint64_t product0 = (uint64_t)philoxMultiplier0 * counter0;
+		uint64_t product1 = (uint64_t)philoxMultiplier1 * counter2;
+
+		uint32_t high0 = (uint32_t)(product0 >> 32);
+		uint32_t low0 = (uint32_t)product0;
+		uint32_t high1 = (uint32_t)(product1 >> 32);
+		uint32_t low1 = (uint32_t)product1;
+
+		counter0 = high1 ^ counter1 ^ key0;
+		counter1 = low1;
+		counter2 = high0 ^ counter3 ^ key1;
+		counter3 = low0;
+
+		key0 += philoxWeyl0;
+		key1 += philoxWeyl1;
+	}
+
+	output[0] = counter0;
+	output[1] = counter1;
+	output[2] = counter2;
+	output[3] = counter3;
+}
+
+uint32_t PhiloxRandom::NextUInt() {
+	if (bufferedRemaining == 0)
+	{
+		GenerateBlock(blockIndex++, buffered);
+		bufferedRemaining = 4;
+	}
+	return buffered[4 - bufferedRemaining--];
+}
+
+/// <summary>
+/// Uniform value in [0, 1)
+/// </summary>
+float PhiloxRandom::NextFloat() {
+	return (NextUInt() >> 8) * uintToUnitFloat;
+}
+
+/// <summary>
+/// Uniform value in [min, max)
+/// </summary>
+float PhiloxRandom::Range(float min, float max) {
+	return min + (max - min) * NextFloat();
+}
+
+/// <summary>
+/// Fills the array with uniform values in [0, 1), a whole block of 4 at a time.
+/// Any values buffered by the single value calls are used first so the sequence is the same either way.
+/// </summary>
+void PhiloxRandom::FillFloats(float* values, size_t count) {
+	size_t i = 0;
+	while (i < count && bufferedRemaining > 0)
+	{
+		values[i++] = NextFloat();
+	}
+
+	uint32_t block[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		GenerateBlock(blockIndex++, block);
+		values[i + 0] = (block[0] >> 8) * uintToUnitFloat;
+		values[i + 1] = (block[1] >> 8) * uintToUnitFloat;
+		values[i + 2] = (block[2] >> 8) * uintToUnitFloat;
+		values[i + 3] = (block[3] >> 8) * uintToUnitFloat;
+	}
+
+	for (; i < count; i++)
+	{
+		values[i] = NextFloat();
+	}
+}
+
+/// <summary>
+/// Fills the array with uniform values in [min, max)
+/// </summary>
+void PhiloxRandom::FillRange(float* values, size_t count, float min, float max) {
+	FillFloats(values, count);
+	float range = max - min;
+	for (size_t i = 0; i < count; i++)
+	{
+		values[i] = min + range * values[i];
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Counter based random number generator (Philox4x32-10). Every output is a pure function of the seed, the stream
+/// and its position in the sequence, so a scene seeded the same way replays exactly, and separate streams (trees,
+/// bubbles, terrain) don't shift each other when one of them draws more values.
+/// State is a couple of counters rather than mt19937's 2.5KB table, and batches are filled 4 values per block.
+/// </summary>
+class PhiloxRandom
+{
+public:
+	PhiloxRandom(uint64_t seed = 0, uint64_t stream = 0);
+	void Seed(uint64_t seed, uint64_t stream = 0);
+	uint32_t NextUInt();
+	float NextFloat();
+	float Range(float min, float max);
+	void FillFloats(float* values, size_t count);
+	void FillRange(float* values, size_t count, float min, float max);
+
+private:
+	uint32_t key[2];
+	uint32_t stream[2];
+	uint64_t blockIndex;
+
+	//Leftover outputs of the last block for the single value calls
+	uint32_t buffered[4];
+	int bufferedRemaining;
+
+	void GenerateBlock(uint64_t index, uint32_t output[4]) const;
+};
@@ -14,6 +14,14 @@ using namespace glm;
 using namespace std;
 
 
+// Colour animation the shaders play on a light, see LightAnimationSet
+struct LightAnimation {
+    int curve = -1;                 // Row of the noise curve texture, -1 for a steady light
+    int ramp = 0;                   // Row of the colour ramp texture the curve picks from
+    float cyclesPerSecond = 0.0f;   // Times a second the curve plays through
+    float phase = 0.0f;             // How far along the curve the light starts, 0 to 1
+};
+
 class PointLight {
 public:
     // Data members
@@ -24,6 +32,7 @@ public:
     vec3 ambient;        // Ambient color of the light
     vec3 diffuse;        // Diffuse color of the light
     vec3 specular;       // Specular color of the light
+    LightAnimation animation;   // Flicker that scales diffuse and specular, none unless set
 
     // Constructor to initialize all members
     PointLight(const vec3& position, float constant, float linear, float quadratic,
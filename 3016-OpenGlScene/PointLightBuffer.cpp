@@ -0,0 +1,132 @@
+#include "PointLightBuffer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+const size_t initialLightCapacity = 32;
+
+PointLightBuffer::PointLightBuffer() {
+}
+
+/// <summary>
+/// Allocates the buffer and its RGBA32F buffer texture, and leaves the texture bound to textureUnit. Needs a current GL context.
+/// </summary>
+void PointLightBuffer::Create(int textureUnit) {
+	capacity = initialLightCapacity;
+	lights.reserve(capacity);
+	ranges.reserve(capacity);
+	texels.reserve(capacity * texelsPerLight);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity * texelsPerLight * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+/// <summary>
+/// Set before adding animated lights, their ranges come from the brightest their ramps get
+/// </summary>
+void PointLightBuffer::SetAnimations(const LightAnimationSet* animations) {
+	this->animations = animations;
+}
+
+void PointLightBuffer::BeginFrame() {
+	lights.clear();
+	ranges.clear();
+	texels.clear();
+}
+
+/// <summary>
+/// Packs a light for this frame. An animated light is kept in GetLights at its brightest, so anything culling
+/// or grouping lights on the CPU never takes it as dimmer than the shaders can make it.
+/// </summary>
+void PointLightBuffer::Add(const PointLight& light) {
+	PointLight brightest = light;
+	if (light.animation.curve >= 0 && animations != NULL)
+	{
+		vec3 rampBrightest = animations->BrightestColour(light.animation.ramp);
+		brightest.diffuse *= rampBrightest;
+		brightest.specular *= rampBrightest;
+	}
+	float range = LightRange(brightest);
+	lights.push_back(brightest);
+	ranges.push_back(range);
+
+	texels.push_back(vec4(light.position, light.constant));
+	texels.push_back(vec4(light.ambient, light.linear));
+	texels.push_back(vec4(light.diffuse, light.quadratic));
+	texels.push_back(vec4(light.specular, range));
+	texels.push_back(vec4((float)light.animation.curve, (float)light.animation.ramp, light.animation.cyclesPerSecond, light.animation.phase));
+}
+
+/// <summary>
+/// Distance at which the light's brightest channel has attenuated to rangeCutoff of itself,
+/// the root of quadratic * d^2 + linear * d + constant = brightness / rangeCutoff
+/// </summary>
+float PointLightBuffer::LightRange(const PointLight& light) {
+	vec3 brightest = max(light.ambient, max(light.diffuse, light.specular));
+	float target = std::max(brightest.r, std::max(brightest.g, brightest.b)) / rangeCutoff;
+	float c = light.constant - target;
+	if (c >= 0.0f)
+	{
+		//Never bright enough to reach the cutoff
+		return 0.0f;
+	}
+	if (light.quadratic > 0.0f)
+	{
+		return (-light.linear + sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+	}
+	if (light.linear > 0.0f)
+	{
+		return -c / light.linear;
+	}
+	return FLT_MAX;
+}
+
+/// <summary>
+/// Orphans the buffer and writes this frame's lights into it. Grows by doubling when there are more lights than fit,
+/// the texture follows the buffer's storage so it doesn't need attaching again.
+/// </summary>
+void PointLightBuffer::Upload() {
+	size_t lightCount = texels.size() / texelsPerLight;
+	while (capacity < lightCount)
+	{
+		capacity *= 2;
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, capacity * texelsPerLight * sizeof(vec4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, texels.size() * sizeof(vec4), texels.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void PointLightBuffer::CleanUp() {
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+	if (buffer != 0)
+	{
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
+
+int PointLightBuffer::GetLightCount() const {
+	return (int)lights.size();
+}
+
+const vector<PointLight>& PointLightBuffer::GetLights() const {
+	return lights;
+}
+
+const vector<float>& PointLightBuffer::GetRanges() const {
+	return ranges;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "LightAnimationSet.h"
+#include "PointLight.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Every point light in the scene packed into one buffer texture that all lit programs read from.
+/// Lights are added each frame, then Upload sends them in one call. The shaders take the count from FrameUniforms
+/// and fetch each light by index, so there is no fixed array size and no per light uniforms to look up.
+/// Each light also gets a range, past which it is faded out entirely, so it can be culled by LightClusterGrid.
+/// A buffer texture is used since shader storage buffers aren't in OpenGL 3.3.
+/// </summary>
+class PointLightBuffer
+{
+public:
+	//--- Texels per light, see FetchPointLight in FragmentShader.f
+	//0: xyz position, w constant
+	//1: rgb ambient, w linear
+	//2: rgb diffuse, w quadratic
+	//3: rgb specular, w range
+	//4: animation curve, -1 for none, ramp, cycles per second and phase
+	static const int texelsPerLight = 5;
+	//Fraction of a light's brightness it is cut off at, its range is where the attenuation falls to this
+	static constexpr float rangeCutoff = 5.0f / 256.0f;
+
+	static float LightRange(const PointLight& light);
+
+	PointLightBuffer();
+	void Create(int textureUnit);
+	void SetAnimations(const LightAnimationSet* animations);
+	void BeginFrame();
+	void Add(const PointLight& light);
+	void Upload();
+	void CleanUp();
+
+	int GetLightCount() const;
+	const vector<PointLight>& GetLights() const;
+	const vector<float>& GetRanges() const;
+
+private:
+	//Ramps animated lights pick their colours from, needed for how far they can reach
+	const LightAnimationSet* animations = NULL;
+	vector<PointLight> lights;
+	vector<float> ranges;
+	vector<vec4> texels;
+	unsigned int buffer = 0;
+	unsigned int texture = 0;
+	//In lights
+	size_t capacity = 0;
+};
@@ -0,0 +1,128 @@
+#include "ProjectileCollisionSystem.h"
+
+#include <algorithm>
+
+ProjectileCollisionSystem::ProjectileCollisionSystem(float projectileRadius) {
+	this->projectileRadius = projectileRadius;
+
+	//Two projectiles touch within one diameter, so a cell that size keeps pair tests to the neighbouring cells
+	projectileGrid.SetCellSize(projectileRadius * 2.0f);
+}
+
+void ProjectileCollisionSystem::AddStaticSphere(vec3 centre, float radius) {
+	staticSphereCentres.push_back(centre);
+	staticSphereRadii.push_back(radius);
+	largestStaticRadius = std::max(largestStaticRadius, radius);
+}
+
+void ProjectileCollisionSystem::AddStaticBox(vec3 minCorner, vec3 maxCorner) {
+	boxMinCorners.push_back(minCorner);
+	boxMaxCorners.push_back(maxCorner);
+}
+
+/// <summary>
+/// Builds the static sphere grid, call once after adding the scene's colliders
+/// </summary>
+void ProjectileCollisionSystem::BuildStatic() {
+	staticGrid.SetCellSize(largestStaticRadius + projectileRadius);
+	staticGrid.Build(staticSphereCentres);
+}
+
+/// <summary>
+/// Rebuilds the projectile grid from the store's current positions and pushes apart everything overlapping.
+/// Projectile pairs each move half the overlap, projectiles touching the scene move all of it.
+/// </summary>
+/// <returns>Number of contacts found this call</returns>
+size_t ProjectileCollisionSystem::Resolve(ProjectileParticleStore& projectileParticles) {
+	size_t count = projectileParticles.Size();
+	projectileGrid.Build(projectileParticles.currentPositionX.data(), projectileParticles.currentPositionY.data(), projectileParticles.currentPositionZ.data(), count);
+
+	// ---------------------------
+	// Projectile vs projectile
+	// ---------------------------
+	float contactDistance = projectileRadius * 2.0f;
+	projectileGrid.FindPairs(contactDistance, contactPairs);
+
+	for (const pair<unsigned int, unsigned int>& contact : contactPairs)
+	{
+		vec3 offset = projectileParticles.PositionAt(contact.second) - projectileParticles.PositionAt(contact.first);
+		float distance = length(offset);
+
+		//Exactly on top of each other has no direction, pick one so they still separate
+		vec3 normal = distance > 0.0001f ? offset / distance : vec3(1.0f, 0.0f, 0.0f);
+		float push = (contactDistance - distance) * 0.5f * repelStrength;
+
+		projectileParticles.Translate(contact.first, -normal * push);
+		projectileParticles.Translate(contact.second, normal * push);
+	}
+	size_t contactCount = contactPairs.size();
+
+	// ---------------------------
+	// Projectile vs scene
+	// ---------------------------
+	for (size_t i = 0; i < count; i++)
+	{
+		vec3 position = projectileParticles.PositionAt(i);
+
+		staticGrid.QueryRadius(position, projectileRadius + largestStaticRadius, nearbyStatic);
+		for (unsigned int s : nearbyStatic)
+		{
+			float minimumDistance = projectileRadius + staticSphereRadii[s];
+			vec3 offset = position - staticSphereCentres[s];
+			float distance = length(offset);
+			if (distance < minimumDistance)
+			{
+				vec3 normal = distance > 0.0001f ? offset / distance : vec3(0.0f, 1.0f, 0.0f);
+				vec3 correction = normal * (minimumDistance - distance);
+				projectileParticles.Translate(i, correction);
+				position += correction;
+				contactCount++;
+			}
+		}
+
+		for (size_t b = 0; b < boxMinCorners.size(); b++)
+		{
+			vec3 closest = clamp(position, boxMinCorners[b], boxMaxCorners[b]);
+			vec3 offset = position - closest;
+			float distance = length(offset);
+			if (distance >= projectileRadius)
+			{
+				continue;
+			}
+
+			vec3 correction;
+			if (distance > 0.0001f)
+			{
+				correction = offset / distance * (projectileRadius - distance);
+			}
+			else {
+				//Centre is inside the box, leave through the nearest face
+				vec3 toMin = position - boxMinCorners[b];
+				vec3 toMax = boxMaxCorners[b] - position;
+				vec3 exitDistance = min(toMin, toMax);
+				int axis = exitDistance.x < exitDistance.y ? (exitDistance.x < exitDistance.z ? 0 : 2) : (exitDistance.y < exitDistance.z ? 1 : 2);
+				correction = vec3(0.0f);
+				correction[axis] = toMin[axis] < toMax[axis] ? -(toMin[axis] + projectileRadius) : toMax[axis] + projectileRadius;
+			}
+			projectileParticles.Translate(i, correction);
+			position += correction;
+			contactCount++;
+		}
+	}
+
+	return contactCount;
+}
+
+/// <summary>
+/// Nearest projectile as of the last Resolve, -1 if none is within maxDistance
+/// </summary>
+int ProjectileCollisionSystem::FindNearestProjectile(vec3 point, float maxDistance, int excludeIndex) const {
+	return projectileGrid.FindNearest(point, maxDistance, excludeIndex);
+}
+
+/// <summary>
+/// Projectiles within radius as of the last Resolve
+/// </summary>
+void ProjectileCollisionSystem::QueryProjectiles(vec3 centre, float radius, vector<unsigned int>& results) const {
+	projectileGrid.QueryRadius(centre, radius, results);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ProjectileParticleStore.h"
+#include "SpatialHashGrid.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Keeps projectiles from passing through each other and through the scene.
+/// Projectiles go into a spatial hash rebuilt every Resolve, static spheres (trees) into a second grid built once,
+/// boxes (the wall) are few enough to test directly. Overlaps are pushed apart by moving the projectile's arc.
+/// </summary>
+class ProjectileCollisionSystem
+{
+public:
+	ProjectileCollisionSystem(float projectileRadius);
+	void AddStaticSphere(vec3 centre, float radius);
+	void AddStaticBox(vec3 minCorner, vec3 maxCorner);
+	void BuildStatic();
+	size_t Resolve(ProjectileParticleStore& projectileParticles);
+	int FindNearestProjectile(vec3 point, float maxDistance, int excludeIndex = -1) const;
+	void QueryProjectiles(vec3 centre, float radius, vector<unsigned int>& results) const;
+
+	//Share of the overlap removed each Resolve, below 1 bubbles ease apart over a few frames instead of snapping
+	float repelStrength = 0.5f;
+
+private:
+	float projectileRadius;
+
+	SpatialHashGrid projectileGrid;
+	SpatialHashGrid staticGrid;
+
+	//--- Static scene
+	vector<vec3> staticSphereCentres;
+	vector<float> staticSphereRadii;
+	float largestStaticRadius = 0.0f;
+	vector<vec3> boxMinCorners;
+	vector<vec3> boxMaxCorners;
+
+	//--- Scratch lists, kept between frames so Resolve doesn't allocate
+	vector<pair<unsigned int, unsigned int>> contactPairs;
+	vector<unsigned int> nearbyStatic;
+};
@@ -0,0 +1,396 @@
+#include "ProjectileParticleStore.h"
+
+//--- SSE is always there on x64, and on x86 builds targeting SSE2. The AVX path is compiled alongside it whatever
+//the build's /arch setting and picked at runtime when the CPU and OS support it, so the same executable runs on both
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PROJECTILE_SIMD_SSE
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__)
+#define PROJECTILE_SIMD_AVX
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//--- Lets GCC and Clang emit AVX in one function without -mavx for the whole file, MSVC needs nothing
+#if defined(PROJECTILE_SIMD_AVX) && defined(__GNUC__)
+#define PROJECTILE_TARGET_AVX __attribute__((target("avx")))
+#else
+#define PROJECTILE_TARGET_AVX
+#endif
+
+/// <summary>
+/// Whether the AVX path can run, the CPU has to have it and the OS has to save the wider registers on a thread switch
+/// </summary>
+static bool CpuSupportsAvx() {
+#if defined(PROJECTILE_SIMD_AVX) && defined(_MSC_VER)
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 1);
+	bool osSavesRegisters = (cpuInfo[2] & (1 << 27)) != 0;
+	bool hasAvx = (cpuInfo[2] & (1 << 28)) != 0;
+	//XMM and YMM state both enabled in XCR0
+	return osSavesRegisters && hasAvx && (_xgetbv(0) & 6) == 6;
+#elif defined(PROJECTILE_SIMD_AVX)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx") != 0;
+#else
+	return false;
+#endif
+}
+
+//--- Checked the first time it's asked rather than at static initialisation, which GCC's CPU checks can run ahead of
+static bool UseAvx() {
+	static const bool supported = CpuSupportsAvx();
+	return supported;
+}
+
+/// <summary>
+/// Index of the lowest set bit, used to walk the lanes flagged in a compare mask
+/// </summary>
+static inline unsigned int LowestSetBit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+ProjectileParticleStore::ProjectileParticleStore(size_t initialCapacity) {
+	Reserve(initialCapacity);
+}
+
+/// <summary>
+/// Adds a particle to the end of the arrays. Equivalent of ArcingProjectileObject::Launch.
+/// </summary>
+/// <returns>Handle that keeps referring to this particle until it is removed</returns>
+ProjectileHandle ProjectileParticleStore::Spawn(vec3 initialVelocity, vec3 initialPosition, float gravityMultiplier, float movespeedMultiplier, float lifetimeMax) {
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		slot = (unsigned int)slotToDense.size();
+		slotToDense.push_back(0);
+		slotGeneration.push_back(0);
+	}
+
+	slotToDense[slot] = (unsigned int)denseToSlot.size();
+	denseToSlot.push_back(slot);
+
+	initialPositionX.push_back(initialPosition.x);
+	initialPositionY.push_back(initialPosition.y);
+	initialPositionZ.push_back(initialPosition.z);
+	initialVelocityX.push_back(initialVelocity.x);
+	initialVelocityY.push_back(initialVelocity.y);
+	initialVelocityZ.push_back(initialVelocity.z);
+	currentPositionX.push_back(initialPosition.x);
+	currentPositionY.push_back(initialPosition.y);
+	currentPositionZ.push_back(initialPosition.z);
+	this->gravityMultiplier.push_back(gravityMultiplier);
+	this->movespeedMultiplier.push_back(movespeedMultiplier);
+	timeSinceStart.push_back(0.0f);
+	this->lifetimeMax.push_back(lifetimeMax);
+
+	return { slot, slotGeneration[slot] };
+}
+
+void ProjectileParticleStore::Remove(ProjectileHandle handle) {
+	if (IsAlive(handle))
+	{
+		RemoveAt(slotToDense[handle.slot]);
+	}
+}
+
+/// <summary>
+/// Removes the particle at this index in O(1) by moving the last particle into its place.
+/// Anything kept in parallel with the store should do the same swap.
+/// </summary>
+void ProjectileParticleStore::RemoveAt(size_t index) {
+	size_t last = denseToSlot.size() - 1;
+	unsigned int removedSlot = denseToSlot[index];
+
+	if (index != last)
+	{
+		initialPositionX[index] = initialPositionX[last];
+		initialPositionY[index] = initialPositionY[last];
+		initialPositionZ[index] = initialPositionZ[last];
+		initialVelocityX[index] = initialVelocityX[last];
+		initialVelocityY[index] = initialVelocityY[last];
+		initialVelocityZ[index] = initialVelocityZ[last];
+		currentPositionX[index] = currentPositionX[last];
+		currentPositionY[index] = currentPositionY[last];
+		currentPositionZ[index] = currentPositionZ[last];
+		gravityMultiplier[index] = gravityMultiplier[last];
+		movespeedMultiplier[index] = movespeedMultiplier[last];
+		timeSinceStart[index] = timeSinceStart[last];
+		lifetimeMax[index] = lifetimeMax[last];
+
+		unsigned int movedSlot = denseToSlot[last];
+		denseToSlot[index] = movedSlot;
+		slotToDense[movedSlot] = (unsigned int)index;
+	}
+
+	initialPositionX.pop_back();
+	initialPositionY.pop_back();
+	initialPositionZ.pop_back();
+	initialVelocityX.pop_back();
+	initialVelocityY.pop_back();
+	initialVelocityZ.pop_back();
+	currentPositionX.pop_back();
+	currentPositionY.pop_back();
+	currentPositionZ.pop_back();
+	gravityMultiplier.pop_back();
+	movespeedMultiplier.pop_back();
+	timeSinceStart.pop_back();
+	lifetimeMax.pop_back();
+	denseToSlot.pop_back();
+
+	//Old handles to this slot are now stale
+	slotGeneration[removedSlot]++;
+	freeSlots.push_back(removedSlot);
+}
+
+bool ProjectileParticleStore::IsAlive(ProjectileHandle handle) const {
+	return handle.slot < slotGeneration.size() && slotGeneration[handle.slot] == handle.generation;
+}
+
+size_t ProjectileParticleStore::IndexOf(ProjectileHandle handle) const {
+	return slotToDense[handle.slot];
+}
+
+ProjectileHandle ProjectileParticleStore::HandleAt(size_t index) const {
+	unsigned int slot = denseToSlot[index];
+	return { slot, slotGeneration[slot] };
+}
+
+vec3 ProjectileParticleStore::PositionAt(size_t index) const {
+	return vec3(currentPositionX[index], currentPositionY[index], currentPositionZ[index]);
+}
+
+/// <summary>
+/// Moves the whole arc, launch point included, so the particle keeps its shape of flight from the new position.
+/// Used to push overlapping particles apart.
+/// </summary>
+void ProjectileParticleStore::Translate(size_t index, vec3 offset) {
+	initialPositionX[index] += offset.x;
+	initialPositionY[index] += offset.y;
+	initialPositionZ[index] += offset.z;
+	currentPositionX[index] += offset.x;
+	currentPositionY[index] += offset.y;
+	currentPositionZ[index] += offset.z;
+}
+
+/// <summary>
+/// Same trajectory as ArcingProjectileObject::UpdatePosition, one particle at a time.
+/// Kept as the reference the SIMD version is measured against.
+/// </summary>
+void ProjectileParticleStore::UpdatePositionsScalar(float deltaTime) {
+	size_t count = denseToSlot.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		float t = timeSinceStart[i] + deltaTime;
+		timeSinceStart[i] = t;
+
+		float scaledTime = t * movespeedMultiplier[i];
+		float gravityDrop = 0.5f * (gravity * gravityMultiplier[i]) * (t * t);
+
+		currentPositionX[i] = initialPositionX[i] + initialVelocityX[i] * scaledTime;
+		currentPositionZ[i] = initialPositionZ[i] + initialVelocityZ[i] * scaledTime;
+		currentPositionY[i] = initialPositionY[i] + initialVelocityY[i] * (t - gravityDrop * movespeedMultiplier[i]);
+	}
+}
+
+/// <summary>
+/// Advances every particle and runs the ShouldDestroy test in the same pass, a batch of lanes at a time.
+/// The compare result of each batch is turned into a bit mask and only the set bits are written out.
+/// Batches are 8 particles with AVX when the CPU has it, otherwise 4 with SSE.
+/// </summary>
+/// <param name="deltaTime">Time since last update</param>
+/// <param name="destroyedIndices">Cleared, then filled with the indices to remove in ascending order.
+/// Remove them from the back so the swap removal never moves an index still waiting in the list.</param>
+void ProjectileParticleStore::UpdatePositions(float deltaTime, vector<unsigned int>& destroyedIndices) {
+	destroyedIndices.clear();
+
+	size_t count = denseToSlot.size();
+	size_t i = 0;
+	float halfGravity = 0.5f * gravity;
+
+#if defined(PROJECTILE_SIMD_AVX)
+	if (UseAvx())
+	{
+		i = UpdateBatchesAvx(deltaTime, destroyedIndices);
+	}
+	else {
+		i = UpdateBatchesSse(deltaTime, destroyedIndices);
+	}
+#elif defined(PROJECTILE_SIMD_SSE)
+	i = UpdateBatchesSse(deltaTime, destroyedIndices);
+#endif
+
+	//--- Leftover particles that don't fill a full batch
+	for (; i < count; i++)
+	{
+		float t = timeSinceStart[i] + deltaTime;
+		timeSinceStart[i] = t;
+
+		float scaledTime = t * movespeedMultiplier[i];
+		float gravityDrop = halfGravity * gravityMultiplier[i] * (t * t);
+
+		currentPositionX[i] = initialPositionX[i] + initialVelocityX[i] * scaledTime;
+		currentPositionZ[i] = initialPositionZ[i] + initialVelocityZ[i] * scaledTime;
+		currentPositionY[i] = initialPositionY[i] + initialVelocityY[i] * (t - gravityDrop * movespeedMultiplier[i]);
+
+		if (ShouldDestroy(i))
+		{
+			destroyedIndices.push_back((unsigned int)i);
+		}
+	}
+}
+
+#if defined(PROJECTILE_SIMD_AVX)
+/// <summary>
+/// UpdatePositions over as many full batches of 8 as fit
+/// </summary>
+/// <returns>Index of the first particle left for the scalar tail</returns>
+PROJECTILE_TARGET_AVX size_t ProjectileParticleStore::UpdateBatchesAvx(float deltaTime, vector<unsigned int>& destroyedIndices) {
+	size_t count = denseToSlot.size();
+	size_t i = 0;
+	float halfGravity = 0.5f * gravity;
+
+	__m256 deltaTimeLanes = _mm256_set1_ps(deltaTime);
+	__m256 halfGravityLanes = _mm256_set1_ps(halfGravity);
+	__m256 zeroLanes = _mm256_setzero_ps();
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 t = _mm256_add_ps(_mm256_loadu_ps(&timeSinceStart[i]), deltaTimeLanes);
+		_mm256_storeu_ps(&timeSinceStart[i], t);
+
+		__m256 movespeed = _mm256_loadu_ps(&movespeedMultiplier[i]);
+		__m256 scaledTime = _mm256_mul_ps(t, movespeed);
+		__m256 gravityDrop = _mm256_mul_ps(_mm256_mul_ps(halfGravityLanes, _mm256_loadu_ps(&gravityMultiplier[i])), _mm256_mul_ps(t, t));
+
+		__m256 x = _mm256_add_ps(_mm256_loadu_ps(&initialPositionX[i]), _mm256_mul_ps(_mm256_loadu_ps(&initialVelocityX[i]), scaledTime));
+		__m256 z = _mm256_add_ps(_mm256_loadu_ps(&initialPositionZ[i]), _mm256_mul_ps(_mm256_loadu_ps(&initialVelocityZ[i]), scaledTime));
+		__m256 y = _mm256_add_ps(_mm256_loadu_ps(&initialPositionY[i]), _mm256_mul_ps(_mm256_loadu_ps(&initialVelocityY[i]), _mm256_sub_ps(t, _mm256_mul_ps(gravityDrop, movespeed))));
+
+		_mm256_storeu_ps(&currentPositionX[i], x);
+		_mm256_storeu_ps(&currentPositionY[i], y);
+		_mm256_storeu_ps(&currentPositionZ[i], z);
+
+		//--- ShouldDestroy, below the ground or out of lifetime
+		__m256 destroyed = _mm256_or_ps(_mm256_cmp_ps(y, zeroLanes, _CMP_LT_OQ), _mm256_cmp_ps(t, _mm256_loadu_ps(&lifetimeMax[i]), _CMP_GE_OQ));
+		unsigned int mask = (unsigned int)_mm256_movemask_ps(destroyed);
+		while (mask != 0)
+		{
+			destroyedIndices.push_back((unsigned int)i + LowestSetBit(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	return i;
+}
+#endif
+
+#if defined(PROJECTILE_SIMD_SSE)
+/// <summary>
+/// UpdatePositions over as many full batches of 4 as fit
+/// </summary>
+/// <returns>Index of the first particle left for the scalar tail</returns>
+size_t ProjectileParticleStore::UpdateBatchesSse(float deltaTime, vector<unsigned int>& destroyedIndices) {
+	size_t count = denseToSlot.size();
+	size_t i = 0;
+	float halfGravity = 0.5f * gravity;
+
+	__m128 deltaTimeLanes = _mm_set1_ps(deltaTime);
+	__m128 halfGravityLanes = _mm_set1_ps(halfGravity);
+	__m128 zeroLanes = _mm_setzero_ps();
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 t = _mm_add_ps(_mm_loadu_ps(&timeSinceStart[i]), deltaTimeLanes);
+		_mm_storeu_ps(&timeSinceStart[i], t);
+
+		__m128 movespeed = _mm_loadu_ps(&movespeedMultiplier[i]);
+		__m128 scaledTime = _mm_mul_ps(t, movespeed);
+		__m128 gravityDrop = _mm_mul_ps(_mm_mul_ps(halfGravityLanes, _mm_loadu_ps(&gravityMultiplier[i])), _mm_mul_ps(t, t));
+
+		__m128 x = _mm_add_ps(_mm_loadu_ps(&initialPositionX[i]), _mm_mul_ps(_mm_loadu_ps(&initialVelocityX[i]), scaledTime));
+		__m128 z = _mm_add_ps(_mm_loadu_ps(&initialPositionZ[i]), _mm_mul_ps(_mm_loadu_ps(&initialVelocityZ[i]), scaledTime));
+		__m128 y = _mm_add_ps(_mm_loadu_ps(&initialPositionY[i]), _mm_mul_ps(_mm_loadu_ps(&initialVelocityY[i]), _mm_sub_ps(t, _mm_mul_ps(gravityDrop, movespeed))));
+
+		_mm_storeu_ps(&currentPositionX[i], x);
+		_mm_storeu_ps(&currentPositionY[i], y);
+		_mm_storeu_ps(&currentPositionZ[i], z);
+
+		//--- ShouldDestroy, below the ground or out of lifetime
+		__m128 destroyed = _mm_or_ps(_mm_cmplt_ps(y, zeroLanes), _mm_cmpge_ps(t, _mm_loadu_ps(&lifetimeMax[i])));
+		unsigned int mask = (unsigned int)_mm_movemask_ps(destroyed);
+		while (mask != 0)
+		{
+			destroyedIndices.push_back((unsigned int)i + LowestSetBit(mask));
+			mask &= mask - 1;
+		}
+	}
+
+	return i;
+}
+#endif
+
+bool ProjectileParticleStore::ShouldDestroy(size_t index) const {
+	return currentPositionY[index] < 0.0f || timeSinceStart[index] >= lifetimeMax[index];
+}
+
+/// <summary>
+/// Particles UpdatePositions advances per batch on this CPU, 1 where there's no SIMD path
+/// </summary>
+int ProjectileParticleStore::GetSimdLanes() {
+#if defined(PROJECTILE_SIMD_AVX)
+	return UseAvx() ? 8 : 4;
+#elif defined(PROJECTILE_SIMD_SSE)
+	return 4;
+#else
+	return 1;
+#endif
+}
+
+size_t ProjectileParticleStore::Size() const {
+	return denseToSlot.size();
+}
+
+void ProjectileParticleStore::Reserve(size_t capacity) {
+	initialPositionX.reserve(capacity);
+	initialPositionY.reserve(capacity);
+	initialPositionZ.reserve(capacity);
+	initialVelocityX.reserve(capacity);
+	initialVelocityY.reserve(capacity);
+	initialVelocityZ.reserve(capacity);
+	currentPositionX.reserve(capacity);
+	currentPositionY.reserve(capacity);
+	currentPositionZ.reserve(capacity);
+	gravityMultiplier.reserve(capacity);
+	movespeedMultiplier.reserve(capacity);
+	timeSinceStart.reserve(capacity);
+	lifetimeMax.reserve(capacity);
+	denseToSlot.reserve(capacity);
+	slotToDense.reserve(capacity);
+	slotGeneration.reserve(capacity);
+	freeSlots.reserve(capacity);
+}
+
+/// <summary>
+/// Removes every particle, existing handles all become stale
+/// </summary>
+void ProjectileParticleStore::Clear() {
+	while (!denseToSlot.empty())
+	{
+		RemoveAt(denseToSlot.size() - 1);
+	}
+}
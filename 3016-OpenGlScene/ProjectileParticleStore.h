@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Stable reference to a particle. Stays valid while other particles are removed and shuffled around,
+/// goes stale once its own particle is removed so a reused slot can't be mistaken for the old particle.
+/// </summary>
+struct ProjectileHandle
+{
+	unsigned int slot;
+	unsigned int generation;
+};
+
+/// <summary>
+/// Structure of arrays store for arcing projectiles, the data only replacement for one ArcingProjectileObject per bubble.
+/// Every attribute lives in its own contiguous array indexed 0 to Size(), so the update is a straight pass over memory.
+/// Removal swaps the last particle into the hole, so indices are not stable, use a ProjectileHandle to hold on to one.
+/// UpdatePositions runs 8 particles at a time with AVX when the CPU has it, checked once at startup, otherwise 4 with SSE.
+/// </summary>
+class ProjectileParticleStore
+{
+public:
+	ProjectileParticleStore(size_t initialCapacity = 0);
+	ProjectileHandle Spawn(vec3 initialVelocity, vec3 initialPosition, float gravityMultiplier, float movespeedMultiplier, float lifetimeMax = 20.0f);
+	void Remove(ProjectileHandle handle);
+	void RemoveAt(size_t index);
+	bool IsAlive(ProjectileHandle handle) const;
+	size_t IndexOf(ProjectileHandle handle) const;
+	ProjectileHandle HandleAt(size_t index) const;
+	vec3 PositionAt(size_t index) const;
+	void Translate(size_t index, vec3 offset);
+	void UpdatePositions(float deltaTime, vector<unsigned int>& destroyedIndices);
+	void UpdatePositionsScalar(float deltaTime);
+	bool ShouldDestroy(size_t index) const;
+	static int GetSimdLanes();
+	size_t Size() const;
+	void Reserve(size_t capacity);
+	void Clear();
+
+	//--- Particle data, entry i of every array belongs to the same particle
+	vector<float> initialPositionX;
+	vector<float> initialPositionY;
+	vector<float> initialPositionZ;
+	vector<float> initialVelocityX;
+	vector<float> initialVelocityY;
+	vector<float> initialVelocityZ;
+	vector<float> currentPositionX;
+	vector<float> currentPositionY;
+	vector<float> currentPositionZ;
+	vector<float> gravityMultiplier;
+	vector<float> movespeedMultiplier;
+	vector<float> timeSinceStart;
+	vector<float> lifetimeMax;
+
+	float gravity = 9.81f;
+
+private:
+	//--- Handle bookkeeping
+	//Dense index -> slot, slot -> dense index, and a generation per slot that is bumped on removal
+	vector<unsigned int> denseToSlot;
+	vector<unsigned int> slotToDense;
+	vector<unsigned int> slotGeneration;
+	vector<unsigned int> freeSlots;
+
+	size_t UpdateBatchesAvx(float deltaTime, vector<unsigned int>& destroyedIndices);
+	size_t UpdateBatchesSse(float deltaTime, vector<unsigned int>& destroyedIndices);
+};
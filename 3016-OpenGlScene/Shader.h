@@ -4,11 +4,97 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstring>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+//--- Plain glUniform calls for each type a uniform can be set from, the program must be in use
+inline void SetUniformValue(GLint location, int value) { glUniform1i(location, value); }
+inline void SetUniformValue(GLint location, float value) { glUniform1f(location, value); }
+inline void SetUniformValue(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::ivec2& value) { glUniform2iv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::ivec3& value) { glUniform3iv(location, 1, &value[0]); }
+inline void SetUniformValue(GLint location, const glm::mat2& value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniformValue(GLint location, const glm::mat3& value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+inline void SetUniformValue(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+//--- Uniform uploads across every program since the counts were last reset, see Shader::ResetUploadCounts
+struct UniformUploadCounts
+{
+    unsigned int issued = 0;
+    //Set to the value the uniform already held, so nothing was sent
+    unsigned int skipped = 0;
+};
+inline UniformUploadCounts& GetUniformUploadCounts()
+{
+    static UniformUploadCounts counts;
+    return counts;
+}
+
+//--- CPU copy of the last value a uniform was set to. A program keeps its uniforms' values until they're set again,
+//so setting one to what it already holds can be skipped
+struct UniformShadow
+{
+    GLint location = -1;
+    //Bytes of the last value, 0 until the uniform is first set
+    unsigned int valueSize = 0;
+    unsigned char value[sizeof(glm::mat4)];
+};
+
+//--- Uploads the value unless the uniform already holds it. NULL for a uniform the program doesn't have, which does nothing
+template<typename T>
+inline void SetUniformShadowed(UniformShadow* shadow, const T& value)
+{
+    static_assert(sizeof(T) <= sizeof(UniformShadow::value), "uniform value too large to shadow");
+    if (shadow == NULL)
+    {
+        return;
+    }
+    if (shadow->valueSize == sizeof(T) && memcmp(shadow->value, &value, sizeof(T)) == 0)
+    {
+        GetUniformUploadCounts().skipped++;
+        return;
+    }
+    memcpy(shadow->value, &value, sizeof(T));
+    shadow->valueSize = sizeof(T);
+    GetUniformUploadCounts().issued++;
+    SetUniformValue(shadow->location, value);
+}
+//Booleans are sent as ints, so one set through setBool and one through setInt compare alike
+inline void SetUniformShadowed(UniformShadow* shadow, bool value)
+{
+    SetUniformShadowed(shadow, (int)value);
+}
+
+//--- Typed uniform found once up front, setting it only compares against the last value before a single glUniform call.
+//A name the program doesn't have, or the compiler optimised out, gives an inactive handle that does nothing, as GL would.
+//The handle belongs to the program it came from, which must be in use when it's set
+template<typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() {}
+    UniformHandle(UniformShadow* uniform) : shadow(uniform) {}
+
+    void Set(const T& value) const
+    {
+        SetUniformShadowed(shadow, value);
+    }
+    bool IsActive() const
+    {
+        return shadow != NULL;
+    }
+
+private:
+    UniformShadow* shadow = NULL;
+};
+
 class Shader
 {
 public:
@@ -69,77 +155,219 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        LoadUniformLocations();
 
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
+    //---Vertex only program for transform feedback, the named outputs are written interleaved into one buffer
+    // in the order given and nothing is rasterised
+    Shader(const char* vertexPath, const std::vector<std::string>& feedbackVaryings)
+    {
+        std::string vertexCode;
+        std::ifstream vShaderFile;
+        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            vShaderFile.open(vertexPath);
+            std::stringstream vShaderStream;
+            vShaderStream << vShaderFile.rdbuf();
+            vShaderFile.close();
+            vertexCode = vShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
+
+        const char* vShaderCode = vertexCode.c_str();
+
+        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+
+        //--- Captured outputs have to be named before linking
+        std::vector<const char*> varyingNames;
+        for (const std::string& varying : feedbackVaryings)
+        {
+            varyingNames.push_back(varying.c_str());
+        }
+        glTransformFeedbackVaryings(ID, (GLsizei)varyingNames.size(), varyingNames.data(), GL_INTERLEAVED_ATTRIBS);
+
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        LoadUniformLocations();
+
+        glDeleteShader(vertex);
+    }
     void Use() const
     {
         glUseProgram(ID);
     }
 
-    //--- Sets the uniform values of the current shader to the value passed in
+    //--- Handles point into the program's uniform table, so a program isn't copied
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    //--- Location of a uniform from the table filled at link time, -1 when the program has no such uniform
+    GLint GetUniformLocation(const std::string& name) const
+    {
+        UniformShadow* shadow = FindUniform(name);
+        return shadow == NULL ? -1 : shadow->location;
+    }
+    //--- Looked up once, usually before the render loop, to set through a typed handle after
+    //UniformHandle<glm::mat4> model = shader.uniform("model");
+    UniformShadow* uniform(const std::string& name) const
+    {
+        return FindUniform(name);
+    }
+
+    //--- Uniform uploads across every program, counted from one reset to the next. Reset once a frame these are per frame
+    static UniformUploadCounts GetUploadCounts()
+    {
+        return GetUniformUploadCounts();
+    }
+    static void ResetUploadCounts()
+    {
+        GetUniformUploadCounts() = UniformUploadCounts();
+    }
+
+    //--- Sets the uniform values of the current shader to the value passed in, unless it already holds it
     void setBool(const std::string& name, bool value) const
     {
-        //Gets the location of the uniform variable denoted by 'name', by a shader in the shader program denoted by ID,
-        //Sets the uniform value to the 'value' part.
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        //Finds the uniform denoted by 'name' in the table built when the program was linked,
+        //Sets the uniform value to the 'value' part if that isn't its value already.
+        SetUniformShadowed(FindUniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        SetUniformShadowed(FindUniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        SetUniformShadowed(FindUniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        SetUniformShadowed(FindUniform(name), value);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        SetUniformShadowed(FindUniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        SetUniformShadowed(FindUniform(name), value);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        SetUniformShadowed(FindUniform(name), glm::vec3(x, y, z));
+    }
+    void setIVec2(const std::string& name, const glm::ivec2& value) const
+    {
+        SetUniformShadowed(FindUniform(name), value);
+    }
+    void setIVec3(const std::string& name, const glm::ivec3& value) const
+    {
+        SetUniformShadowed(FindUniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        SetUniformShadowed(FindUniform(name), value);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        SetUniformShadowed(FindUniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        SetUniformShadowed(FindUniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        SetUniformShadowed(FindUniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        SetUniformShadowed(FindUniform(name), mat);
     }
 
     private:
+        //--- One entry per active uniform location, with the last value it was set to. Filled at link time and never
+        //resized after, handles point into it. Setting a uniform changes its shadow, hence mutable under the const setters
+        mutable std::vector<UniformShadow> uniforms;
+        //--- Every active uniform's index in uniforms, by name, so setting one never has to ask the driver
+        std::unordered_map<std::string, size_t> uniformIndices;
+
+        UniformShadow* FindUniform(const std::string& name) const
+        {
+            std::unordered_map<std::string, size_t>::const_iterator found = uniformIndices.find(name);
+            return found == uniformIndices.end() ? NULL : &uniforms[found->second];
+        }
+        void AddUniform(const std::string& name, GLint location)
+        {
+            UniformShadow shadow;
+            shadow.location = location;
+            uniformIndices[name] = uniforms.size();
+            uniforms.push_back(shadow);
+        }
+
+        //--- Filled once after linking. Arrays are listed as their first element, "lights[0]",
+        //so each element is added by its own name, and the bare array name shares the first element's entry.
+        //Uniforms in blocks have no location and are left out, they're set through their buffer
+        void LoadUniformLocations()
+        {
+            uniforms.clear();
+            uniformIndices.clear();
+            GLint uniformCount = 0;
+            GLint maxNameLength = 0;
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+            std::vector<GLchar> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+
+            for (GLint i = 0; i < uniformCount; i++)
+            {
+                GLsizei nameLength = 0;
+                GLint arraySize = 0;
+                GLenum type = 0;
+                glGetActiveUniform(ID, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+                std::string name(nameBuffer.data(), nameLength);
+
+                GLint location = glGetUniformLocation(ID, name.c_str());
+                if (location < 0)
+                {
+                    continue;
+                }
+                AddUniform(name, location);
+
+                //"name[0]" is the only way arrays are listed, the other elements aren't guaranteed to follow it
+                size_t suffix = name.size() >= 3 ? name.rfind("[0]") : std::string::npos;
+                if (suffix != std::string::npos && suffix == name.size() - 3)
+                {
+                    std::string baseName = name.substr(0, suffix);
+                    uniformIndices[baseName] = uniformIndices[name];
+                    for (GLint element = 1; element < arraySize; element++)
+                    {
+                        std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                        AddUniform(elementName, glGetUniformLocation(ID, elementName.c_str()));
+                    }
+                }
+            }
+        }
+
         //--- Utility methods to check shader compilation success
         void checkCompileErrors(GLuint shader, std::string type)
         {
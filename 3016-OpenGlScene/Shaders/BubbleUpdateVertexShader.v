@@ -0,0 +1,78 @@
+#version 330 core
+//One bubble record per vertex, see GpuBubbleSimulation for the layout
+layout (location = 0) in vec4 renderData;
+layout (location = 1) in vec4 launchPosition;
+layout (location = 2) in vec4 launchVelocity;
+layout (location = 3) in vec4 life;
+
+//Captured by transform feedback into the other buffer, same layout
+out vec4 outRenderData;
+out vec4 outLaunchPosition;
+out vec4 outLaunchVelocity;
+out vec4 outLife;
+
+//Pre made launches, three texels each: position and gravity multiplier, velocity and movespeed multiplier,
+//then cooldown and phase
+uniform samplerBuffer launches;
+uniform int launchCount;
+uniform int bubbleCount;
+
+uniform float deltaTime;
+uniform float gravity;
+uniform float lifetime;
+
+//Baked curl noise wind, see WindField. Box corner and size map a position to texture coordinates
+uniform bool useWind;
+uniform sampler3D windField;
+uniform vec3 windOrigin;
+uniform vec3 windExtent;
+
+void main()
+{
+	vec3 initialPosition = launchPosition.xyz;
+	float gravityMultiplier = launchPosition.w;
+	vec3 initialVelocity = launchVelocity.xyz;
+	float movespeedMultiplier = launchVelocity.w;
+	float age = life.x + deltaTime;
+	float launchNumber = life.z;
+	float phase = life.w;
+
+	//--- Same closed form arc as ProjectileParticleStore
+	float t = max(age, 0.0);
+	float scaledTime = t * movespeedMultiplier;
+	float gravityDrop = 0.5 * gravity * gravityMultiplier * t * t;
+	vec3 position = initialPosition + initialVelocity * scaledTime;
+	position.y = initialPosition.y + initialVelocity.y * (t - gravityDrop * movespeedMultiplier);
+
+	//--- Drift, moves the launch position too so the arc carries on from where the wind leaves it
+	if (useWind && age >= 0.0)
+	{
+		vec3 drift = texture(windField, (position - windOrigin) / windExtent).xyz * deltaTime;
+		initialPosition += drift;
+		position += drift;
+	}
+
+	//--- Popped or expired, take the next launch for this bubble and wait out its cooldown
+	if (age >= 0.0 && (position.y < 0.0 || age >= life.y))
+	{
+		launchNumber += 1.0;
+		int launchIndex = (gl_VertexID + int(launchNumber) * bubbleCount) % launchCount;
+
+		vec4 nextPosition = texelFetch(launches, launchIndex * 3);
+		vec4 nextVelocity = texelFetch(launches, launchIndex * 3 + 1);
+		vec4 nextTiming = texelFetch(launches, launchIndex * 3 + 2);
+
+		initialPosition = nextPosition.xyz;
+		gravityMultiplier = nextPosition.w;
+		initialVelocity = nextVelocity.xyz;
+		movespeedMultiplier = nextVelocity.w;
+		age = -nextTiming.x;
+		phase = nextTiming.y;
+		position = initialPosition;
+	}
+
+	outRenderData = vec4(position, age >= 0.0 ? phase : -1.0);
+	outLaunchPosition = vec4(initialPosition, gravityMultiplier);
+	outLaunchVelocity = vec4(initialVelocity, movespeedMultiplier);
+	outLife = vec4(age, lifetime, launchNumber, phase);
+}
@@ -0,0 +1,150 @@
+#version 330 core
+struct PointLight {    
+    vec3 position;
+    
+    float constant;
+    float linear;
+    float quadratic;  
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    //Past this it contributes nothing, so lights can be culled by distance
+    float range;
+};  
+
+flat in int LightIndex;
+
+out vec4 FragColour;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
+
+//Every point light packed by PointLightBuffer, five texels each
+uniform samplerBuffer pointLightData;
+
+//--- G-buffer written by the lit shaders' geometry pass, see DeferredRenderer
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gDiffuse;
+uniform sampler2D gSpecular;
+uniform sampler2D gAmbient;
+
+//Light animation, see LightAnimationSet. A curve row of ramp positions, played from FrameUniforms' time,
+//picks a colour off a ramp row to scale a light's diffuse and specular by.
+uniform sampler2D lightAnimationCurves;
+uniform sampler2D lightAnimationRamps;
+
+// x curve, -1 for a steady light, y ramp, z cycles per second, w phase
+vec3 AnimatedColour(vec4 animation)
+{
+    if (animation.x < 0.0)
+        return vec3(1.0);
+    vec2 curveSize = vec2(textureSize(lightAnimationCurves, 0));
+    float position = texture(lightAnimationCurves, vec2(fract(time * animation.z + animation.w), (animation.x + 0.5) / curveSize.y)).r;
+    vec2 rampSize = vec2(textureSize(lightAnimationRamps, 0));
+    float along = (clamp(position, 0.0, 1.0) * (rampSize.x - 1.0) + 0.5) / rampSize.x;
+    return texture(lightAnimationRamps, vec2(along, (animation.y + 0.5) / rampSize.y)).rgb;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 positionConstant = texelFetch(pointLightData, index * 5);
+    vec4 ambientLinear = texelFetch(pointLightData, index * 5 + 1);
+    vec4 diffuseQuadratic = texelFetch(pointLightData, index * 5 + 2);
+    vec4 specular = texelFetch(pointLightData, index * 5 + 3);
+    vec3 colour = AnimatedColour(texelFetch(pointLightData, index * 5 + 4));
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.w, diffuseQuadratic.w,
+        ambientLinear.rgb, diffuseQuadratic.rgb * colour, specular.rgb * colour, specular.w);
+}
+
+//Cached shadow maps of the lamps, see ShadowCubeCache. A row of six cube faces per lamp, each texel the distance to
+//the nearest caster over lampShadowFar. The lamps are the first shadowedLightCount point lights, none while they're baked.
+uniform sampler2DShadow lampShadowAtlas;
+uniform int shadowedLightCount;
+uniform int lampShadowRows;
+uniform float lampShadowFar;
+uniform float lampShadowFaceSize;
+
+//Same face order and orientation as the cube faces ShadowCubeCache renders
+const vec3 shadowFaceForward[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 shadowFaceUp[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+float LampShadow(int lightIndex, vec3 lightPosition, vec3 fragPos)
+{
+    if (lightIndex >= shadowedLightCount)
+        return 1.0;
+
+    vec3 toFrag = fragPos - lightPosition;
+    vec3 absolute = abs(toFrag);
+    int face = absolute.x >= absolute.y && absolute.x >= absolute.z ? (toFrag.x >= 0.0 ? 0 : 1) :
+        (absolute.y >= absolute.z ? (toFrag.y >= 0.0 ? 2 : 3) : (toFrag.z >= 0.0 ? 4 : 5));
+    vec3 forward = shadowFaceForward[face];
+    vec3 up = shadowFaceUp[face];
+    vec2 projected = vec2(dot(toFrag, cross(forward, up)), dot(toFrag, up)) / dot(toFrag, forward);
+    // kept a texel in from the face's edges so the filter doesn't reach into the next face
+    vec2 faceCoord = clamp(projected * 0.5 + 0.5, vec2(1.0 / lampShadowFaceSize), vec2(1.0 - 1.0 / lampShadowFaceSize));
+    vec2 atlasCoord = (vec2(face, lightIndex) + faceCoord) / vec2(6.0, float(lampShadowRows));
+
+    // a texel covers more the further away it is, so the bias grows with distance
+    float distance = length(toFrag);
+    float bias = 0.05 + distance * 3.0 / lampShadowFaceSize;
+    return texture(lampShadowAtlas, vec3(atlasCoord, min((distance - bias) / lampShadowFar, 1.0)));
+}
+
+//Same as CalcPointLight in FragmentShader.f and ModelFragmentShader.f, with the material read back from the G-buffer
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 normalShininess = texelFetch(gNormal, texel, 0);
+    //Background, nothing was drawn here in the geometry pass
+    if (normalShininess.xyz == vec3(0.0)) {
+        discard;
+    }
+
+    PointLight light = FetchPointLight(LightIndex);
+    vec3 fragPos = texelFetch(gPosition, texel, 0).xyz;
+    vec3 normal = normalShininess.xyz;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), normalShininess.w);
+    // attenuation
+    float distance    = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + 
+  			     light.quadratic * (distance * distance));    
+    // fade out to nothing at the light's range, so it matches whether or not the light was culled
+    float fade = clamp(1.0 - pow(distance / max(light.range, 0.0001), 4.0), 0.0, 1.0);
+    attenuation *= fade * fade;
+    // combine results
+    vec3 ambient  = light.ambient  * texelFetch(gAmbient, texel, 0).rgb;
+    vec3 diffuse  = light.diffuse  * diff * texelFetch(gDiffuse, texel, 0).rgb;
+    vec3 specular = light.specular * spec * texelFetch(gSpecular, texel, 0).rgb;
+    float shadow = LampShadow(LightIndex, light.position, fragPos);
+    diffuse *= shadow;
+    specular *= shadow;
+    FragColour = vec4((ambient + diffuse + specular) * attenuation, 1.0);
+}
@@ -0,0 +1,39 @@
+#version 330 core
+//Corner of a cube from -1 to 1, scaled to each light's range so it bounds everything the light reaches
+layout (location = 0) in vec3 aPos;
+
+//One instance per light, the instance id is the light's index in PointLightBuffer
+flat out int LightIndex;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
+
+uniform samplerBuffer pointLightData;
+
+void main()
+{
+	vec4 positionConstant = texelFetch(pointLightData, gl_InstanceID * 5);
+	float range = texelFetch(pointLightData, gl_InstanceID * 5 + 3).w;
+
+	LightIndex = gl_InstanceID;
+	gl_Position = projection * view * vec4(positionConstant.xyz + aPos * range, 1.0);
+}
@@ -32,7 +32,6 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };  
-uniform DirLight dirLight;
 
 struct PointLight {    
     vec3 position;
@@ -44,9 +43,9 @@ struct PointLight {
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
+    //Past this it contributes nothing, so lights can be culled by distance
+    float range;
 };  
-#define NR_POINT_LIGHTS 11
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 
 
 struct SpotLight {
@@ -63,8 +62,6 @@ struct SpotLight {
     vec3 diffuse;
     vec3 specular;       
 };
-
-uniform SpotLight spotLight;
  
 
 in vec2 TexCoord;
@@ -76,34 +73,231 @@ uniform sampler2D texture1;
 
 uniform vec3 lightColor;
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 uniform bool useTexture;
-uniform int staticPointLights = 4;
-uniform int dynamicPointLights = 0;
 
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+//G-buffer, only bound in the deferred geometry pass, see DeferredRenderer. Drawing to the screen drops these.
+layout (location = 1) out vec4 GPosition;
+layout (location = 2) out vec4 GNormal;
+layout (location = 3) out vec4 GDiffuse;
+layout (location = 4) out vec4 GSpecular;
+layout (location = 5) out vec4 GAmbient;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
+
+//Ambient terms stay per program, the textured and model shaders are lit differently, the rest of both lights comes from FrameUniforms
+uniform vec3 dirLightAmbient;
+uniform vec3 spotLightAmbient;
+
+//Lamp lighting baked by StaticLightBake over the texture coordinates, x diffuse and y ambient for a lamp colour of one.
+//The colours are black while the lamps are lit as point lights instead.
+uniform sampler2D staticLightMap;
+uniform bool useStaticLightMap;
+uniform vec3 staticLampDiffuse;
+//The lamps' shared flicker, laid out like a light's animation texel in pointLightData
+uniform vec4 staticLampAnimation;
+uniform vec3 staticLampAmbient;
+
+//Every point light packed by PointLightBuffer, five texels each, FrameUniforms holds how many there are
+uniform samplerBuffer pointLightData;
+
+//Light animation, see LightAnimationSet. A curve row of ramp positions, played from FrameUniforms' time,
+//picks a colour off a ramp row to scale a light's diffuse and specular by.
+uniform sampler2D lightAnimationCurves;
+uniform sampler2D lightAnimationRamps;
+
+// x curve, -1 for a steady light, y ramp, z cycles per second, w phase
+vec3 AnimatedColour(vec4 animation)
+{
+    if (animation.x < 0.0)
+        return vec3(1.0);
+    vec2 curveSize = vec2(textureSize(lightAnimationCurves, 0));
+    float position = texture(lightAnimationCurves, vec2(fract(time * animation.z + animation.w), (animation.x + 0.5) / curveSize.y)).r;
+    vec2 rampSize = vec2(textureSize(lightAnimationRamps, 0));
+    float along = (clamp(position, 0.0, 1.0) * (rampSize.x - 1.0) + 0.5) / rampSize.x;
+    return texture(lightAnimationRamps, vec2(along, (animation.y + 0.5) / rampSize.y)).rgb;
+}
+
+PointLight FetchPointLight(int index)
+{
+    vec4 positionConstant = texelFetch(pointLightData, index * 5);
+    vec4 ambientLinear = texelFetch(pointLightData, index * 5 + 1);
+    vec4 diffuseQuadratic = texelFetch(pointLightData, index * 5 + 2);
+    vec4 specular = texelFetch(pointLightData, index * 5 + 3);
+    vec3 colour = AnimatedColour(texelFetch(pointLightData, index * 5 + 4));
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.w, diffuseQuadratic.w,
+        ambientLinear.rgb, diffuseQuadratic.rgb * colour, specular.rgb * colour, specular.w);
+}
+
+//--- Which point lights a fragment loops over, set from Main's PointLightMode
+#define POINT_LIGHTS_ALL 0
+#define POINT_LIGHTS_CLUSTERED 1
+#define POINT_LIGHTS_PER_DRAW 2
+//None here, DeferredRenderer adds them afterwards from the G-buffer
+#define POINT_LIGHTS_DEFERRED 3
+#define POINT_LIGHTS_TREE 4
+uniform int pointLightMode;
+
+//Per draw list, see DrawLightAssigner. x offset into the index list, y count.
+uniform usamplerBuffer drawLightIndices;
+uniform ivec2 drawLights;
+
+//Clustered lighting, see LightClusterGrid. Each cluster is an offset and count into the light index list.
+uniform usamplerBuffer lightClusters;
+uniform usamplerBuffer lightClusterIndices;
+uniform ivec3 clusterDimensions;
+uniform vec2 clusterScreenSize;
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+
+int ClusterIndex(vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterScreenSize * vec2(clusterDimensions.xy)), ivec2(0), clusterDimensions.xy - 1);
+    int slice = clamp(int(floor(log(depth) * clusterDepthScale + clusterDepthBias)), 0, clusterDimensions.z - 1);
+    return (slice * clusterDimensions.y + tile.y) * clusterDimensions.x + tile.x;
+}
+
+//Cached shadow maps of the lamps, see ShadowCubeCache. A row of six cube faces per lamp, each texel the distance to
+//the nearest caster over lampShadowFar. The lamps are the first shadowedLightCount point lights, none while they're baked.
+uniform sampler2DShadow lampShadowAtlas;
+uniform int shadowedLightCount;
+uniform int lampShadowRows;
+uniform float lampShadowFar;
+uniform float lampShadowFaceSize;
+
+//Same face order and orientation as the cube faces ShadowCubeCache renders
+const vec3 shadowFaceForward[6] = vec3[6](vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+const vec3 shadowFaceUp[6] = vec3[6](vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0));
+
+float LampShadow(int lightIndex, vec3 lightPosition, vec3 fragPos)
+{
+    if (lightIndex >= shadowedLightCount)
+        return 1.0;
+
+    vec3 toFrag = fragPos - lightPosition;
+    vec3 absolute = abs(toFrag);
+    int face = absolute.x >= absolute.y && absolute.x >= absolute.z ? (toFrag.x >= 0.0 ? 0 : 1) :
+        (absolute.y >= absolute.z ? (toFrag.y >= 0.0 ? 2 : 3) : (toFrag.z >= 0.0 ? 4 : 5));
+    vec3 forward = shadowFaceForward[face];
+    vec3 up = shadowFaceUp[face];
+    vec2 projected = vec2(dot(toFrag, cross(forward, up)), dot(toFrag, up)) / dot(toFrag, forward);
+    // kept a texel in from the face's edges so the filter doesn't reach into the next face
+    vec2 faceCoord = clamp(projected * 0.5 + 0.5, vec2(1.0 / lampShadowFaceSize), vec2(1.0 - 1.0 / lampShadowFaceSize));
+    vec2 atlasCoord = (vec2(face, lightIndex) + faceCoord) / vec2(6.0, float(lampShadowRows));
+
+    // a texel covers more the further away it is, so the bias grows with distance
+    float distance = length(toFrag);
+    float bias = 0.05 + distance * 3.0 / lampShadowFaceSize;
+    return texture(lampShadowAtlas, vec3(atlasCoord, min((distance - bias) / lampShadowFar, 1.0)));
+}
+
+//Light hierarchy, see LightTree. Six texels a node, the first four its aggregate light laid out like pointLightData,
+//then the bounds of its lights with the brightest channel of their summed colours, and the first child's index
+//or, for a single light, -1 - its index in pointLightData.
+#define LIGHT_TREE_MAX_DEPTH 32
+uniform samplerBuffer lightTreeNodes;
+uniform float lightTreeErrorBound;
+uniform float lightTreeRelativeError;
+
+PointLight FetchTreeLight(int node)
+{
+    vec4 positionConstant = texelFetch(lightTreeNodes, node * 6);
+    vec4 ambientLinear = texelFetch(lightTreeNodes, node * 6 + 1);
+    vec4 diffuseQuadratic = texelFetch(lightTreeNodes, node * 6 + 2);
+    vec4 specular = texelFetch(lightTreeNodes, node * 6 + 3);
+    return PointLight(positionConstant.xyz, positionConstant.w, ambientLinear.w, diffuseQuadratic.w,
+        ambientLinear.rgb, diffuseQuadratic.rgb, specular.rgb, specular.w);
+}
+
+//Irradiance probes, see IrradianceProbeGrid. The point lights that didn't make it into pointLightData, as L2
+//spherical harmonics of their diffuse light and a sum of their ambient, eight slabs of z slices per probe.
+uniform sampler3D irradianceProbes;
+uniform bool useIrradianceProbes;
+uniform vec3 irradianceProbeOrigin;
+uniform vec3 irradianceProbeExtent;
+uniform ivec3 irradianceProbeResolution;
+
+const int irradianceProbeSlabs = 8;
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 textureColour); 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour);  
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour, float shadow);  
+vec3 CalcIndexedPointLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour);
+vec3 CalcLightTree(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour);
+vec3 CalcProbeLight(vec3 normal, vec3 fragPos, vec3 textureColour);
 
 void main()
 {
     vec3 textureColour = texture(texture1, TexCoord * 5).rgb;
 
+    // lights
+    DirLight dirLight = DirLight(dirLightDirection, dirLightAmbient, dirLightDiffuse, dirLightSpecular);
+    SpotLight spotLight = SpotLight(spotLightPosition, spotLightDirection, spotLightCutOff, spotLightOuterCutOff,
+        spotLightConstant, spotLightLinear, spotLightQuadratic, spotLightAmbient, spotLightDiffuse, spotLightSpecular);
+
     // properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
 
     // phase 1: Directional lighting
     vec3 result = CalcDirLight(dirLight, norm, viewDir, textureColour);
-    // phase 2: Point lights
-    for(int i = 0; i < staticPointLights + dynamicPointLights; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir, textureColour);    
+    // phase 2: Point lights, all of them, only the ones culled for this fragment's cluster or this draw, or the light tree's cut
+    if (pointLightMode == POINT_LIGHTS_CLUSTERED) {
+        uvec2 cluster = texelFetch(lightClusters, ClusterIndex(FragPos)).xy;
+        for(uint n = 0u; n < cluster.y; n++)
+            result += CalcIndexedPointLight(int(texelFetch(lightClusterIndices, int(cluster.x + n)).r), norm, FragPos, viewDir, textureColour);
+    }
+    else if (pointLightMode == POINT_LIGHTS_PER_DRAW) {
+        for(int n = 0; n < drawLights.y; n++)
+            result += CalcIndexedPointLight(int(texelFetch(drawLightIndices, drawLights.x + n).r), norm, FragPos, viewDir, textureColour);
+    }
+    else if (pointLightMode == POINT_LIGHTS_TREE) {
+        result += CalcLightTree(norm, FragPos, viewDir, textureColour);
+    }
+    else if (pointLightMode == POINT_LIGHTS_ALL) {
+        for(int i = 0; i < pointLightCount; i++)
+            result += CalcIndexedPointLight(i, norm, FragPos, viewDir, textureColour);
+    }
     // phase 3: Spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir, textureColour);    
+    // phase 4: Baked lamps, diffuse and ambient only
+    if (useStaticLightMap) {
+        vec2 staticLight = texture(staticLightMap, TexCoord).rg;
+        result += (staticLampAmbient * staticLight.y * material.ambient + staticLampDiffuse * AnimatedColour(staticLampAnimation) * staticLight.x * material.diffuse) * textureColour;
+    }
+    // phase 5: Probe lights, ambient and diffuse only
+    if (useIrradianceProbes)
+        result += CalcProbeLight(norm, FragPos, textureColour);
     
     FragColor = vec4(result, 1.0);
+
+    // reflectances the point lights are applied to, CalcPointLight's terms without the light
+    GPosition = vec4(FragPos, 1.0);
+    GNormal = vec4(norm, material.shininess);
+    GDiffuse = vec4(textureColour * material.diffuse, 1.0);
+    GSpecular = vec4(material.specular, 1.0);
+    GAmbient = vec4(textureColour * material.ambient, 1.0);
     
 }
 
@@ -125,7 +319,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 textureColour)
     return (ambient + diffuse + specular);
 }  
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour, float shadow)
 {
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
@@ -137,16 +331,26 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     float distance    = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + 
   			     light.quadratic * (distance * distance));    
+    // fade out to nothing at the light's range, so it matches whether or not the light was culled
+    float fade = clamp(1.0 - pow(distance / max(light.range, 0.0001), 4.0), 0.0, 1.0);
+    attenuation *= fade * fade;
     // combine results
     vec3 ambient  = light.ambient  * textureColour * material.ambient;
     vec3 diffuse  = light.diffuse  * diff * textureColour* material.diffuse;
     vec3 specular = light.specular * spec * material.specular;
     ambient  *= attenuation;
-    diffuse  *= attenuation;
-    specular *= attenuation;
+    diffuse  *= attenuation * shadow;
+    specular *= attenuation * shadow;
     return (ambient + diffuse + specular);
 } 
 
+// fetches a light from pointLightData and shades it, shadowed if it's a lamp
+vec3 CalcIndexedPointLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour)
+{
+    PointLight light = FetchPointLight(index);
+    return CalcPointLight(light, normal, fragPos, viewDir, textureColour, LampShadow(index, light.position, fragPos));
+}
+
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour)
 {
@@ -171,4 +375,79 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
+}
+
+// walks the light tree from the root, shading each group as its aggregate light once that's close enough
+vec3 CalcLightTree(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 textureColour)
+{
+    vec3 result = vec3(0.0);
+    if (pointLightCount == 0)
+        return result;
+
+    int stack[LIGHT_TREE_MAX_DEPTH];
+    int stackSize = 1;
+    stack[0] = 0;
+    while (stackSize > 0) {
+        int node = stack[--stackSize];
+        PointLight light = FetchTreeLight(node);
+        // nothing under the node reaches this far
+        if (length(light.position - fragPos) > light.range)
+            continue;
+
+        vec4 boundsMin = texelFetch(lightTreeNodes, node * 6 + 4);
+        vec4 boundsMax = texelFetch(lightTreeNodes, node * 6 + 5);
+        int child = int(boundsMax.w);
+        if (child < 0) {
+            // shaded from pointLightData rather than its copy in the node, so it animates
+            int lightIndex = -child - 1;
+            result += CalcIndexedPointLight(lightIndex, normal, fragPos, viewDir, textureColour);
+            continue;
+        }
+
+        // each member is somewhere in the bounds, so it arrives attenuated between the bounds' near and far side
+        // and from within the angle they cover. The aggregate can be off by at most that spread.
+        vec3 centre = (boundsMin.xyz + boundsMax.xyz) * 0.5;
+        float radius = length(boundsMax.xyz - boundsMin.xyz) * 0.5;
+        float distance = length(centre - fragPos);
+        if (distance > radius) {
+            float nearest = distance - radius;
+            float furthest = distance + radius;
+            float strongest = 1.0 / (light.constant + light.linear * nearest + light.quadratic * nearest * nearest);
+            float weakest = 1.0 / (light.constant + light.linear * furthest + light.quadratic * furthest * furthest);
+            float error = boundsMin.w * (strongest - weakest + strongest * 2.0 * radius / distance);
+            // an error is less noticeable the brighter the fragment already is, the light so far is a lower bound on that
+            float allowedError = max(lightTreeErrorBound, lightTreeRelativeError * max(result.r, max(result.g, result.b)));
+            if (error <= allowedError) {
+                result += CalcPointLight(light, normal, fragPos, viewDir, textureColour, 1.0);
+                continue;
+            }
+        }
+
+        stack[stackSize++] = child;
+        stack[stackSize++] = child + 1;
+    }
+    return result;
+}
+
+// reads the probe grid trilinearly, held at the outermost probes past its edges, and evaluates the harmonics at the normal
+vec3 CalcProbeLight(vec3 normal, vec3 fragPos, vec3 textureColour)
+{
+    vec3 resolution = vec3(irradianceProbeResolution);
+    vec3 cell = clamp((fragPos - irradianceProbeOrigin) / irradianceProbeExtent * resolution, vec3(0.5), resolution - 0.5);
+    vec4 slabs[irradianceProbeSlabs];
+    for(int slab = 0; slab < irradianceProbeSlabs; slab++)
+        slabs[slab] = texture(irradianceProbes, vec3(cell.xy / resolution.xy, (cell.z + float(slab) * resolution.z) / (resolution.z * float(irradianceProbeSlabs))));
+
+    // L2 basis, the same constants as IrradianceProbeGrid's
+    vec4 basisLow = vec4(0.282095, 0.488603 * normal.y, 0.488603 * normal.z, 0.488603 * normal.x);
+    vec4 basisHigh = vec4(1.092548 * normal.x * normal.y, 1.092548 * normal.y * normal.z,
+        0.315392 * (3.0 * normal.z * normal.z - 1.0), 1.092548 * normal.x * normal.z);
+    float basisLast = 0.546274 * (normal.x * normal.x - normal.y * normal.y);
+    vec3 probeDiffuse = vec3(dot(slabs[0], basisLow) + dot(slabs[1], basisHigh) + slabs[6].r * basisLast,
+        dot(slabs[2], basisLow) + dot(slabs[3], basisHigh) + slabs[6].g * basisLast,
+        dot(slabs[4], basisLow) + dot(slabs[5], basisHigh) + slabs[6].b * basisLast);
+    // two bands ring a little negative behind a light
+    probeDiffuse = max(probeDiffuse, vec3(0.0));
+    vec3 probeAmbient = slabs[7].rgb;
+    return probeAmbient * textureColour * material.ambient + probeDiffuse * textureColour * material.diffuse;
 }
\ No newline at end of file
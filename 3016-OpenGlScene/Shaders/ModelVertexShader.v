@@ -9,16 +9,43 @@ out vec3 FragPos;
 out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
 
 uniform bool useInstancing; 
 
+//Lamp lighting baked per vertex by StaticLightBake, x diffuse and y ambient for a lamp colour of one.
+//staticLightBake.x is this draw's first vertex, -1 for none, and .y the vertices per instance when instanced.
+uniform samplerBuffer staticLightVertices;
+uniform ivec2 staticLightBake;
+out vec2 StaticLight;
+
 
 void main()
 {
     
     TexCoord = aTexCoords;   
+    StaticLight = staticLightBake.x < 0 ? vec2(0.0) : texelFetch(staticLightVertices, staticLightBake.x + gl_InstanceID * staticLightBake.y + gl_VertexID).rg;   
     FragPos = vec3(model * vec4(aPos, 1.0)); 
     Normal = mat3(transpose(inverse(model))) * aNormal;  
 
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPosition;
+uniform float lampShadowFar;
+
+void main()
+{
+    //Distance rather than the face's projected depth, so a lookup only needs the direction and length to the light
+    gl_FragDepth = length(FragPos - lightPosition) / lampShadowFar;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 instanceMatrix;
+
+out vec3 FragPos;
+
+uniform mat4 model;
+uniform bool useInstancing;
+//One cube face of one light, see ShadowCubeCache
+uniform mat4 faceViewProjection;
+
+void main()
+{
+    FragPos = vec3((useInstancing ? instanceMatrix : model) * vec4(aPos, 1.0));
+    gl_Position = faceViewProjection * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,97 @@
+#version 330 core
+struct Material{
+ 	vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+uniform Material material;
+
+struct Light {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+uniform Light light;
+
+
+out vec4 FragColour;
+
+in vec3 FragPos;
+flat in vec3 ImpostorCentre;
+
+uniform float impostorRadius;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
+
+uniform vec3 lightPos;
+
+
+void main()
+{
+    // ray / sphere intersection
+    // Ray starts at the camera and passes through this fragment of the quad
+    vec3 rayDir = normalize(FragPos - viewPos);
+    vec3 centreToCamera = viewPos - ImpostorCentre;
+
+    float b = dot(centreToCamera, rayDir);
+    float c = dot(centreToCamera, centreToCamera) - impostorRadius * impostorRadius;
+    float discriminant = b * b - c;
+
+    //Ray misses the sphere, this fragment is one of the quad's corners
+    if (discriminant < 0.0)
+        discard;
+
+    //Nearest of the two intersections is the visible surface
+    float t = -b - sqrt(discriminant);
+    vec3 hitPos = viewPos + rayDir * t;
+    vec3 norm = normalize(hitPos - ImpostorCentre);
+
+    // depth
+    // Written from the hit point so impostors intersect the rest of the scene like the real mesh
+    vec4 clipPos = projection * view * vec4(hitPos, 1.0);
+    float ndcDepth = clipPos.z / clipPos.w;
+    gl_FragDepth = (gl_DepthRange.diff * ndcDepth + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+	// ambient
+	vec3 ambient  = light.ambient * material.ambient;
+
+    // diffuse
+    vec3 lightDir = normalize(lightPos - hitPos);
+    float diff = max(dot(norm, lightDir), 0.0);
+	vec3 diffuse  = light.diffuse * (diff * material.diffuse);
+
+    // specular
+    vec3 viewDir = -rayDir;
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+	vec3 specular = light.specular * (spec * material.specular);
+
+    vec3 result = ambient + diffuse + specular;
+    FragColour = vec4(result, 1.0);
+
+}
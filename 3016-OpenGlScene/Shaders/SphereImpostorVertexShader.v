@@ -0,0 +1,86 @@
+#version 330 core
+//Quad corner in the range -1 to 1, expanded around the sphere centre below
+layout (location = 0) in vec2 aCorner;
+//Per bubble, xyz world position of the sphere centre, w is the phase, only its sign (hidden when negative) matters here
+layout (location = 1) in vec4 instanceData;
+//Analytic bubbles only, instanceData is then the launch position and gravity multiplier, see AnalyticBubbleSystem
+layout (location = 2) in vec4 launchVelocity;
+layout (location = 3) in vec4 launchTiming;
+
+out vec3 FragPos;
+flat out vec3 ImpostorCentre;
+
+uniform float impostorRadius;
+
+//Set when every bubble is drawn by both shaders from one buffer, this one keeps the bubbles beyond impostorDistance
+uniform bool splitByDistance;
+uniform float impostorDistance;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
+
+//Set when instances are launches rather than positions, the position is worked out from time here
+uniform bool analyticTrajectory;
+uniform float gravity;
+
+//Closed form arc of ProjectileParticleStore, same as SphereVertexShader.v
+vec4 AnalyticBubble()
+{
+	float t = time - launchTiming.x;
+	if (t < 0.0 || time >= launchTiming.y) {
+		return vec4(0.0, 0.0, 0.0, -1.0);
+	}
+
+	float gravityMultiplier = instanceData.w;
+	float movespeedMultiplier = launchVelocity.w;
+	vec3 position = instanceData.xyz + launchVelocity.xyz * t * movespeedMultiplier;
+	position.y = instanceData.y + launchVelocity.y * (t - 0.5 * gravity * gravityMultiplier * t * t * movespeedMultiplier);
+	return vec4(position, launchTiming.z);
+}
+
+void main()
+{
+	vec4 bubble = analyticTrajectory ? AnalyticBubble() : instanceData;
+
+	vec3 impostorCentre = bubble.xyz;
+	ImpostorCentre = impostorCentre;
+
+	//Quad faces the camera along the ray to the sphere centre rather than the view direction,
+	//so the silhouette stays covered when the bubble is off to the side of the screen
+	vec3 toCamera = normalize(viewPos - impostorCentre);
+	vec3 cameraUp = vec3(view[0][1], view[1][1], view[2][1]);
+	vec3 quadRight = normalize(cross(cameraUp, toCamera));
+	vec3 quadUp = cross(toCamera, quadRight);
+
+	//Pulled forward to the near side of the sphere, a quad of half size 'radius' here always
+	//contains the projected sphere under perspective
+	vec3 quadCentre = impostorCentre + toCamera * impostorRadius;
+
+	FragPos = quadCentre + (quadRight * aCorner.x + quadUp * aCorner.y) * impostorRadius;
+
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+
+	//Bubbles waiting to launch have a negative phase, they and the mesh side of the split are moved past the far plane
+	if (bubble.w < 0.0 || (splitByDistance && length(impostorCentre - viewPos) <= impostorDistance)) {
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+	}
+}
@@ -4,6 +4,11 @@ layout (location = 0) in vec3 aPos;
 layout(location = 1) in vec2 texCoord;
 layout(location = 2) in vec3 colour;
 layout (location = 3) in vec3 aNormal;
+//Per bubble, xyz world position and w a phase that offsets the noise animation
+layout (location = 4) in vec4 instanceData;
+//Analytic bubbles only, instanceData is then the launch position and gravity multiplier, see AnalyticBubbleSystem
+layout (location = 5) in vec4 launchVelocity;
+layout (location = 6) in vec4 launchTiming;
 
 out vec3 colourFrag;
 out vec3 Normal;
@@ -11,20 +16,64 @@ out vec3 FragPos;
 
 uniform sampler2D firstNoiseTexture;
 uniform sampler2D secondNoiseTexture; 
-uniform float time; 
 uniform float displacementScale; 
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+//Per frame constants shared by every program, filled once a frame by FrameUniformBuffer. Keep in step with FrameUniformData.
+layout (std140) uniform FrameUniforms
+{
+	mat4 projection;
+	mat4 view;
+	vec3 viewPos;
+	float time;
+	vec3 dirLightDirection;
+	int pointLightCount;
+	vec3 dirLightDiffuse;
+	vec3 dirLightSpecular;
+	vec3 spotLightPosition;
+	float spotLightCutOff;
+	vec3 spotLightDirection;
+	float spotLightOuterCutOff;
+	vec3 spotLightDiffuse;
+	float spotLightConstant;
+	vec3 spotLightSpecular;
+	float spotLightLinear;
+	float spotLightQuadratic;
+};
 
 uniform bool flatShading;
+uniform bool useInstancing;
 
-void main(){
+//Set when every bubble is drawn by both shaders from one buffer, this one keeps the bubbles within impostorDistance
+uniform bool splitByDistance;
+uniform float impostorDistance;
+
+//Set when instances are launches rather than positions, the position is worked out from time here
+uniform bool analyticTrajectory;
+uniform float gravity;
+
+//Closed form arc of ProjectileParticleStore. Before launch and after retiring the phase is negative so it is hidden.
+vec4 AnalyticBubble()
+{
+	float t = time - launchTiming.x;
+	if (t < 0.0 || time >= launchTiming.y) {
+		return vec4(0.0, 0.0, 0.0, -1.0);
+	}
 
+	float gravityMultiplier = instanceData.w;
+	float movespeedMultiplier = launchVelocity.w;
+	vec3 position = instanceData.xyz + launchVelocity.xyz * t * movespeedMultiplier;
+	position.y = instanceData.y + launchVelocity.y * (t - 0.5 * gravity * gravityMultiplier * t * t * movespeedMultiplier);
+	return vec4(position, launchTiming.z);
+}
 
+void main(){
+
+	vec4 bubble = analyticTrajectory ? AnalyticBubble() : instanceData;
 	
-	vec2 animatedUV = texCoord + vec2(time * 0.1, 0.0);
+	float phase = useInstancing ? bubble.w : 0.0;
+	vec2 animatedUV = texCoord + vec2((time + phase * 10.0) * 0.1, phase);
 	
 	float primaryNoiseValue = texture(firstNoiseTexture, animatedUV).r;
     float secondaryNoiseValue = texture(secondNoiseTexture, animatedUV * 1.5).r;
@@ -33,12 +82,23 @@ void main(){
 
 	vec3 displacedPosition = aPos + normalize(aPos) * combinedNoise * displacementScale;
 
-	FragPos = vec3(model * vec4(displacedPosition, 1.0));
+	if(useInstancing){
+		//Instanced bubbles are only translated, so the normal needs no transforming
+		FragPos = displacedPosition + bubble.xyz;
+		Normal = aNormal;
+	}
+	else {
+		FragPos = vec3(model * vec4(displacedPosition, 1.0));
+		Normal = mat3(transpose(inverse(model))) * aNormal;
+	}
 
-	gl_Position = projection * view * model * vec4(displacedPosition, 1.0);
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+
+	//Bubbles waiting to launch have a negative phase, they and the impostor side of the split are moved past the far plane
+	if (useInstancing && (bubble.w < 0.0 || (splitByDistance && length(bubble.xyz - viewPos) > impostorDistance))) {
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+	}
 
 	
 	colourFrag = colour;
-
-	Normal = mat3(transpose(inverse(model))) * aNormal;
 }
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "ShadowCubeCache.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+#include "PointLightBuffer.h"
+
+//--- Cube face directions in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards, with the same up vectors as
+//a cube map's faces. Keep in step with shadowFaceForward and shadowFaceUp in the lit shaders.
+const vec3 faceForward[ShadowCubeCache::facesPerLight] = {
+	vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f),
+	vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f)
+};
+const vec3 faceUp[ShadowCubeCache::facesPerLight] = {
+	vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f),
+	vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f)
+};
+//Casters closer to the light than this are clipped
+const float shadowNearPlane = 0.05f;
+
+ShadowCubeCache::ShadowCubeCache() {
+}
+
+ShadowCubeCache::~ShadowCubeCache() {
+	delete depthShader;
+}
+
+/// <summary>
+/// Allocates the atlas, a row of six faceSize faces per light, with every face dirty. Needs a current GL context.
+/// </summary>
+/// <param name="lights">Lights that never move, their order is the atlas's row order and the shaders' light index</param>
+void ShadowCubeCache::Create(const vector<PointLight*>& lights, int faceSize, int textureUnit) {
+	this->faceSize = faceSize;
+	this->textureUnit = textureUnit;
+
+	lightPositions.clear();
+	farDistance = 0.0f;
+	for (PointLight* light : lights)
+	{
+		lightPositions.push_back(light->position);
+		farDistance = std::max(farDistance, PointLightBuffer::LightRange(*light));
+	}
+	//A light that never fades out still needs a finite far plane
+	farDistance = std::min(std::max(farDistance, 1.0f), 1000.0f);
+
+	int rows = std::max((int)lightPositions.size(), 1);
+	glGenTextures(1, &atlasTexture);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, faceSize * facesPerLight, faceSize * rows, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	//Filtered depth comparison, each lookup is a 2x2 percentage closer filter
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlasTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cerr << "Shadow atlas framebuffer is not complete" << endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	depthShader = new Shader("Shaders/ShadowDepthVertexShader.v", "Shaders/ShadowDepthFragmentShader.f");
+	depthShader->Use();
+	depthShader->setFloat("lampShadowFar", farDistance);
+
+	InvalidateAll();
+}
+
+/// <summary>
+/// Sets the atlas and its layout on a program that shades the lights, they don't change after Create
+/// </summary>
+void ShadowCubeCache::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("lampShadowAtlas", textureUnit);
+	shader.setInt("lampShadowRows", std::max((int)lightPositions.size(), 1));
+	shader.setFloat("lampShadowFar", farDistance);
+	shader.setFloat("lampShadowFaceSize", (float)faceSize);
+}
+
+/// <summary>
+/// Marks the faces that see any part of a sphere for rendering again, for when static geometry inside it is added, moved or removed
+/// </summary>
+void ShadowCubeCache::Invalidate(vec3 centre, float radius) {
+	for (int light = 0; light < (int)lightPositions.size(); light++)
+	{
+		for (int face = 0; face < facesPerLight; face++)
+		{
+			if (FaceReaches(light, face, centre, radius))
+			{
+				dirty[light * facesPerLight + face] = true;
+			}
+		}
+	}
+}
+
+void ShadowCubeCache::InvalidateAll() {
+	dirty.assign(lightPositions.size() * facesPerLight, true);
+}
+
+/// <summary>
+/// Starts rendering dirty faces, at most faceBudget of them. Call NextFace until it returns false, drawing the casters
+/// with GetDepthShader each time, then EndUpdate.
+/// </summary>
+void ShadowCubeCache::BeginUpdate(int faceBudget) {
+	facesLeft = faceBudget;
+	facesUpdated = 0;
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glEnable(GL_SCISSOR_TEST);
+	//Leaves and the floor are single sided, both sides have to cast
+	glDisable(GL_CULL_FACE);
+}
+
+/// <summary>
+/// Moves on to the next dirty face, clears it and sets the depth shader up to draw into it
+/// </summary>
+/// <returns>False once the budget is spent or no face is dirty</returns>
+bool ShadowCubeCache::NextFace() {
+	int faceCount = (int)dirty.size();
+	if (facesLeft <= 0 || faceCount == 0)
+	{
+		return false;
+	}
+
+	int index = -1;
+	for (int i = 0; i < faceCount; i++)
+	{
+		int candidate = (nextDirtyFace + i) % faceCount;
+		if (dirty[candidate])
+		{
+			index = candidate;
+			break;
+		}
+	}
+	if (index < 0)
+	{
+		return false;
+	}
+
+	dirty[index] = false;
+	nextDirtyFace = (index + 1) % faceCount;
+	facesLeft--;
+	facesUpdated++;
+
+	int light = index / facesPerLight;
+	int face = index % facesPerLight;
+	glViewport(face * faceSize, light * faceSize, faceSize, faceSize);
+	glScissor(face * faceSize, light * faceSize, faceSize, faceSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	vec3 position = lightPositions[light];
+	mat4 projection = perspective(radians(90.0f), 1.0f, shadowNearPlane, farDistance);
+	mat4 view = lookAt(position, position + faceForward[face], faceUp[face]);
+	depthShader->Use();
+	depthShader->setMat4("faceViewProjection", projection * view);
+	depthShader->setVec3("lightPosition", position);
+	return true;
+}
+
+void ShadowCubeCache::EndUpdate() {
+	glEnable(GL_CULL_FACE);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+Shader& ShadowCubeCache::GetDepthShader() {
+	return *depthShader;
+}
+
+/// <summary>
+/// Copies the atlas back to the CPU for Visibility. Slow, for baking after the faces have been rendered.
+/// </summary>
+void ShadowCubeCache::ReadBack() {
+	int width = faceSize * facesPerLight;
+	int height = faceSize * std::max((int)lightPositions.size(), 1);
+	atlasDepths.resize((size_t)width * height);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, atlasDepths.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+/// <summary>
+/// How much of a light reaches a position, from the copy ReadBack took. Matches LampShadow in the lit shaders,
+/// filtered 2x2 the way the hardware compare is.
+/// </summary>
+float ShadowCubeCache::Visibility(int light, vec3 position) const {
+	if (atlasDepths.empty())
+	{
+		return 1.0f;
+	}
+
+	vec3 toPosition = position - lightPositions[light];
+	int face;
+	vec2 projected = ProjectToFace(toPosition, face);
+	float edge = 1.0f / faceSize;
+	vec2 faceCoord = glm::clamp(projected * 0.5f + 0.5f, vec2(edge), vec2(1.0f - edge));
+
+	float distance = length(toPosition);
+	float bias = 0.05f + distance * 3.0f / faceSize;
+	float reference = std::min((distance - bias) / farDistance, 1.0f);
+
+	//Texel centres either side of the point, weighted bilinearly
+	int width = faceSize * facesPerLight;
+	vec2 texel = (vec2((float)face, (float)light) + faceCoord) * (float)faceSize - 0.5f;
+	ivec2 corner = ivec2(floor(texel));
+	vec2 weight = texel - vec2(corner);
+	float visibility = 0.0f;
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = 0; x < 2; x++)
+		{
+			ivec2 sample = glm::clamp(corner + ivec2(x, y), ivec2(0), ivec2(width - 1, (int)(atlasDepths.size() / width) - 1));
+			float lit = reference <= atlasDepths[(size_t)sample.y * width + sample.x] ? 1.0f : 0.0f;
+			visibility += lit * (x ? weight.x : 1.0f - weight.x) * (y ? weight.y : 1.0f - weight.y);
+		}
+	}
+	return visibility;
+}
+
+void ShadowCubeCache::CleanUp() {
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &atlasTexture);
+	framebuffer = atlasTexture = 0;
+}
+
+/// <summary>
+/// Faces rendered by the last update
+/// </summary>
+int ShadowCubeCache::GetFacesUpdated() const {
+	return facesUpdated;
+}
+
+int ShadowCubeCache::GetDirtyFaceCount() const {
+	return (int)count(dirty.begin(), dirty.end(), true);
+}
+
+/// <summary>
+/// Whether a sphere is within a face's far distance and inside its four side planes
+/// </summary>
+bool ShadowCubeCache::FaceReaches(int light, int face, vec3 centre, float radius) const {
+	vec3 toCentre = centre - lightPositions[light];
+	if (length(toCentre) - radius > farDistance || dot(toCentre, faceForward[face]) < -radius)
+	{
+		return false;
+	}
+
+	vec3 right = cross(faceForward[face], faceUp[face]);
+	vec3 sides[4] = { right, -right, faceUp[face], -faceUp[face] };
+	for (vec3 side : sides)
+	{
+		//Outward normal of the side plane, 45 degrees between the side and back along the face's direction
+		vec3 normal = normalize(side - faceForward[face]);
+		if (dot(toCentre, normal) > radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// Picks the face a direction from the light falls on and where on it, -1 to 1 across the face
+/// </summary>
+vec2 ShadowCubeCache::ProjectToFace(vec3 toPosition, int& face) const {
+	vec3 absolute = abs(toPosition);
+	if (absolute.x >= absolute.y && absolute.x >= absolute.z)
+	{
+		face = toPosition.x >= 0.0f ? 0 : 1;
+	}
+	else if (absolute.y >= absolute.z)
+	{
+		face = toPosition.y >= 0.0f ? 2 : 3;
+	}
+	else
+	{
+		face = toPosition.z >= 0.0f ? 4 : 5;
+	}
+
+	vec3 right = cross(faceForward[face], faceUp[face]);
+	return vec2(dot(toPosition, right), dot(toPosition, faceUp[face])) / dot(toPosition, faceForward[face]);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "PointLight.h"
+#include "Shader.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Omnidirectional shadow maps for lights that never move, rendered once and kept until something near them changes.
+/// Every light's six cube faces sit in one depth texture atlas, a row of faces per light, each texel the distance to the
+/// nearest caster over the far distance. A single 2D atlas rather than cube maps lets a shader pick the light by index,
+/// which OpenGL 3.3 doesn't allow across an array of samplers.
+/// A face is only rendered when it is dirty: all of them to begin with, then the ones Invalidate is told a change reaches.
+/// Each update renders at most a budget of dirty faces, oldest first, so a change costs a few frames of stale shadow
+/// rather than a spike. Only static geometry is drawn into the faces. The bubbles are see through, so they cast none.
+/// </summary>
+class ShadowCubeCache
+{
+public:
+	static const int facesPerLight = 6;
+
+	ShadowCubeCache();
+	~ShadowCubeCache();
+	void Create(const vector<PointLight*>& lights, int faceSize, int textureUnit);
+	void Attach(Shader& shader) const;
+
+	void Invalidate(vec3 centre, float radius);
+	void InvalidateAll();
+
+	void BeginUpdate(int faceBudget);
+	bool NextFace();
+	void EndUpdate();
+	Shader& GetDepthShader();
+
+	void ReadBack();
+	float Visibility(int light, vec3 position) const;
+
+	void CleanUp();
+
+	int GetFacesUpdated() const;
+	int GetDirtyFaceCount() const;
+
+private:
+	vector<vec3> lightPositions;
+	//Every light's shadows reach out to this, the largest range among them
+	float farDistance = 1.0f;
+	int faceSize = 256;
+	int textureUnit = 0;
+
+	unsigned int atlasTexture = 0;
+	unsigned int framebuffer = 0;
+	Shader* depthShader = NULL;
+
+	//Per face, light * facesPerLight + face
+	vector<bool> dirty;
+	//Face the next update starts looking from, so every dirty face gets its turn
+	int nextDirtyFace = 0;
+	int facesLeft = 0;
+	int facesUpdated = 0;
+	int previousFramebuffer = 0;
+	int previousViewport[4] = { 0, 0, 0, 0 };
+
+	//CPU copy of the atlas from ReadBack, for baking
+	vector<float> atlasDepths;
+
+	bool FaceReaches(int light, int face, vec3 centre, float radius) const;
+	vec2 ProjectToFace(vec3 toPosition, int& face) const;
+};
@@ -0,0 +1,76 @@
+#include "SignificanceManager.h"
+
+#include <algorithm>
+
+//Objects behind the camera are still heard and still light what is in view, so they are marked down rather than dropped
+const float behindCameraWeight = 0.5f;
+
+SignificanceManager::SignificanceManager() {
+}
+
+/// <summary>
+/// Camera the scores are taken from, set once a frame before Evaluate
+/// </summary>
+/// <param name="projectionScale">Pixels per unit at a distance of one, screen height / (2 * tan(fovY / 2))</param>
+void SignificanceManager::SetViewpoint(vec3 position, vec3 forward, float projectionScale) {
+	viewPosition = position;
+	viewForward = forward;
+	this->projectionScale = projectionScale;
+}
+
+/// <summary>
+/// Scores every object, ranks them, then walks the ranking handing out each budget in turn
+/// </summary>
+/// <param name="positions">Object centres, results come back in the same order</param>
+/// <param name="radius">Bounding radius shared by every object</param>
+void SignificanceManager::Evaluate(const vector<vec3>& positions, float radius) {
+	size_t count = positions.size();
+	results.resize(count);
+	ranking.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		vec3 toObject = positions[i] - viewPosition;
+		float score = ScreenRadius(radius, length(toObject));
+		if (dot(toObject, viewForward) < -radius)
+		{
+			score *= behindCameraWeight;
+		}
+
+		results[i].score = score;
+		results[i].impostor = score < impostorScore;
+		ranking[i] = (unsigned int)i;
+	}
+
+	//Ties go to the lower index, so equal scores don't trade budgets back and forth between frames
+	sort(ranking.begin(), ranking.end(), [this](unsigned int a, unsigned int b) {
+		if (results[a].score != results[b].score)
+		{
+			return results[a].score > results[b].score;
+		}
+		return a < b;
+	});
+
+	for (size_t rank = 0; rank < count; rank++)
+	{
+		Significance& significance = results[ranking[rank]];
+		significance.light = rank < maxLights;
+		significance.voice = rank < maxVoices;
+		significance.fullRate = rank < maxFullRateUpdates;
+	}
+}
+
+const Significance& SignificanceManager::Get(size_t index) const {
+	return results[index];
+}
+
+size_t SignificanceManager::Size() const {
+	return results.size();
+}
+
+/// <summary>
+/// Projected radius in pixels of a sphere at a distance, for turning a distance based setting into a score
+/// </summary>
+float SignificanceManager::ScreenRadius(float radius, float distance) const {
+	return radius * projectionScale / std::max(distance, radius);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// What one object is given this frame, decided by SignificanceManager
+/// </summary>
+struct Significance
+{
+	//Projected radius in pixels, halved behind the camera
+	float score;
+	bool light;
+	bool voice;
+	bool fullRate;
+	bool impostor;
+};
+
+/// <summary>
+/// Ranks dynamic objects by how large they are on screen and hands out the expensive extras to the most significant:
+/// a light in the shaders' array, a playing voice, an update every tick, and the full mesh instead of an impostor.
+/// The first three are budgets, the top maxLights objects get a light and so on, so the cost stays flat however
+/// many objects there are. The impostor swap is a plain score threshold since the quad is always the cheaper draw.
+/// </summary>
+class SignificanceManager
+{
+public:
+	SignificanceManager();
+	void SetViewpoint(vec3 position, vec3 forward, float projectionScale);
+	void Evaluate(const vector<vec3>& positions, float radius);
+	const Significance& Get(size_t index) const;
+	size_t Size() const;
+
+	float ScreenRadius(float radius, float distance) const;
+
+	//--- Budgets, the highest scoring objects get these first
+	size_t maxLights = 8;
+	size_t maxVoices = 8;
+	size_t maxFullRateUpdates = 32;
+	//Below this projected radius in pixels the object is drawn as an impostor
+	float impostorScore = 0.0f;
+
+private:
+	vec3 viewPosition = vec3(0.0f);
+	vec3 viewForward = vec3(0.0f, 0.0f, -1.0f);
+	float projectionScale = 1.0f;
+
+	vector<Significance> results;
+	//Object indices from most to least significant
+	vector<unsigned int> ranking;
+};
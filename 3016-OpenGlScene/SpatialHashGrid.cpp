@@ -0,0 +1,248 @@
+#include "SpatialHashGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+SpatialHashGrid::SpatialHashGrid(float cellSize) {
+	SetCellSize(cellSize);
+}
+
+/// <summary>
+/// Only takes effect on the next Build
+/// </summary>
+void SpatialHashGrid::SetCellSize(float cellSize) {
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+}
+
+float SpatialHashGrid::GetCellSize() const {
+	return cellSize;
+}
+
+/// <summary>
+/// Rebuilds the grid from structure of arrays positions, such as the projectile store's current positions
+/// </summary>
+void SpatialHashGrid::Build(const float* x, const float* y, const float* z, size_t count) {
+	positions.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		positions[i] = vec3(x[i], y[i], z[i]);
+	}
+	SortIntoBuckets();
+}
+
+void SpatialHashGrid::Build(const vector<vec3>& positions) {
+	this->positions = positions;
+	SortIntoBuckets();
+}
+
+/// <summary>
+/// Every point within radius of centre, in no particular order
+/// </summary>
+/// <param name="results">Cleared, then filled with the indices of the points found</param>
+void SpatialHashGrid::QueryRadius(vec3 centre, float radius, vector<unsigned int>& results) const {
+	results.clear();
+	if (positions.empty())
+	{
+		return;
+	}
+
+	ivec3 minCell = CellOf(centre - vec3(radius));
+	ivec3 maxCell = CellOf(centre + vec3(radius));
+	float radiusSquared = radius * radius;
+
+	for (int cx = minCell.x; cx <= maxCell.x; cx++)
+	{
+		for (int cy = minCell.y; cy <= maxCell.y; cy++)
+		{
+			for (int cz = minCell.z; cz <= maxCell.z; cz++)
+			{
+				ivec3 cell(cx, cy, cz);
+				unsigned int bucket = BucketOf(cell);
+				for (unsigned int k = cellStart[bucket]; k < cellStart[bucket + 1]; k++)
+				{
+					vec3 offset = sortedPositions[k] - centre;
+					//Other cells can share this bucket, the cell test stops a point being reported twice
+					if (dot(offset, offset) <= radiusSquared && sortedCells[k] == cell)
+					{
+						results.push_back(sortedIndices[k]);
+					}
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Closest point to this position, searched one shell of cells at a time outwards from its cell.
+/// Stops as soon as no unvisited shell can hold anything closer.
+/// </summary>
+/// <param name="maxDistance">Nothing further than this is returned, also bounds how many shells are searched</param>
+/// <param name="excludeIndex">Point to skip, pass the querying object's own index to find its nearest neighbour</param>
+/// <returns>Index of the nearest point, or -1 if there is none within maxDistance</returns>
+int SpatialHashGrid::FindNearest(vec3 point, float maxDistance, int excludeIndex) const {
+	int bestIndex = -1;
+	if (positions.empty())
+	{
+		return bestIndex;
+	}
+
+	float bestDistanceSquared = maxDistance * maxDistance;
+	ivec3 centreCell = CellOf(point);
+	int maxRing = (int)(maxDistance * inverseCellSize) + 1;
+
+	for (int ring = 0; ring <= maxRing; ring++)
+	{
+		for (int dx = -ring; dx <= ring; dx++)
+		{
+			for (int dy = -ring; dy <= ring; dy++)
+			{
+				for (int dz = -ring; dz <= ring; dz++)
+				{
+					//Shell only, the inside was covered by the earlier rings
+					if (std::max(std::abs(dx), std::max(std::abs(dy), std::abs(dz))) != ring)
+					{
+						continue;
+					}
+					VisitCell(centreCell + ivec3(dx, dy, dz), point, excludeIndex, bestIndex, bestDistanceSquared);
+				}
+			}
+		}
+
+		//Anything in the next shell out is at least ring cells away
+		float searchedDistance = ring * cellSize;
+		if (bestIndex != -1 && bestDistanceSquared <= searchedDistance * searchedDistance)
+		{
+			break;
+		}
+	}
+
+	return bestIndex;
+}
+
+/// <summary>
+/// Every pair of points within radius of each other, each pair reported once with the lower index first
+/// </summary>
+/// <param name="pairs">Cleared, then filled with the pairs found</param>
+void SpatialHashGrid::FindPairs(float radius, vector<pair<unsigned int, unsigned int>>& pairs) const {
+	pairs.clear();
+
+	float radiusSquared = radius * radius;
+	int cellRange = (int)std::ceil(radius * inverseCellSize);
+
+	for (size_t k = 0; k < sortedIndices.size(); k++)
+	{
+		unsigned int first = sortedIndices[k];
+		vec3 firstPosition = sortedPositions[k];
+		ivec3 firstCell = sortedCells[k];
+
+		for (int dx = -cellRange; dx <= cellRange; dx++)
+		{
+			for (int dy = -cellRange; dy <= cellRange; dy++)
+			{
+				for (int dz = -cellRange; dz <= cellRange; dz++)
+				{
+					ivec3 cell = firstCell + ivec3(dx, dy, dz);
+					unsigned int bucket = BucketOf(cell);
+					for (unsigned int j = cellStart[bucket]; j < cellStart[bucket + 1]; j++)
+					{
+						unsigned int second = sortedIndices[j];
+						if (second <= first)
+						{
+							continue;
+						}
+
+						vec3 offset = sortedPositions[j] - firstPosition;
+						if (dot(offset, offset) <= radiusSquared && sortedCells[j] == cell)
+						{
+							pairs.push_back(make_pair(first, second));
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+vec3 SpatialHashGrid::PositionOf(unsigned int index) const {
+	return positions[index];
+}
+
+size_t SpatialHashGrid::Size() const {
+	return positions.size();
+}
+
+ivec3 SpatialHashGrid::CellOf(vec3 position) const {
+	return ivec3(floor(position * inverseCellSize));
+}
+
+unsigned int SpatialHashGrid::BucketOf(ivec3 cell) const {
+	//Large primes from Teschner et al. 2003, optimized spatial hashing for collision detection
+	unsigned int hash = ((unsigned int)cell.x * 73856093u) ^ ((unsigned int)cell.y * 19349663u) ^ ((unsigned int)cell.z * 83492791u);
+	return hash & tableMask;
+}
+
+/// <summary>
+/// Counting sort of every point by bucket. Counts go into cellStart, a running sum turns them into bucket ends,
+/// then points are placed back to front, walking each end down to its bucket's start.
+/// </summary>
+void SpatialHashGrid::SortIntoBuckets() {
+	size_t count = positions.size();
+
+	//Twice as many buckets as points keeps most buckets to one cell
+	unsigned int tableSize = 64;
+	while (tableSize < count * 2)
+	{
+		tableSize *= 2;
+	}
+	tableMask = tableSize - 1;
+
+	cellStart.assign(tableSize + 1, 0);
+	itemCell.resize(count);
+	itemBucket.resize(count);
+	sortedIndices.resize(count);
+	sortedPositions.resize(count);
+	sortedCells.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		itemCell[i] = CellOf(positions[i]);
+		unsigned int bucket = BucketOf(itemCell[i]);
+		itemBucket[i] = bucket;
+		cellStart[bucket]++;
+	}
+
+	unsigned int runningTotal = 0;
+	for (unsigned int bucket = 0; bucket <= tableSize; bucket++)
+	{
+		runningTotal += cellStart[bucket];
+		cellStart[bucket] = runningTotal;
+	}
+
+	for (size_t i = count; i-- > 0;)
+	{
+		unsigned int sortedIndex = --cellStart[itemBucket[i]];
+		sortedIndices[sortedIndex] = (unsigned int)i;
+		sortedPositions[sortedIndex] = positions[i];
+		sortedCells[sortedIndex] = itemCell[i];
+	}
+}
+
+void SpatialHashGrid::VisitCell(ivec3 cell, vec3 point, int excludeIndex, int& bestIndex, float& bestDistanceSquared) const {
+	unsigned int bucket = BucketOf(cell);
+	for (unsigned int k = cellStart[bucket]; k < cellStart[bucket + 1]; k++)
+	{
+		if ((int)sortedIndices[k] == excludeIndex)
+		{
+			continue;
+		}
+
+		vec3 offset = sortedPositions[k] - point;
+		float distanceSquared = dot(offset, offset);
+		if (distanceSquared <= bestDistanceSquared && sortedCells[k] == cell)
+		{
+			bestDistanceSquared = distanceSquared;
+			bestIndex = (int)sortedIndices[k];
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Uniform grid over points, hashed into a fixed table so the world has no bounds and empty space costs nothing.
+/// Build is a counting sort by cell, O(n) with no per cell allocation, so it is cheap enough to redo every frame
+/// for moving objects. Results are the indices the points were built with.
+/// Pick a cell size around the largest query radius, a radius query then only visits the 27 cells around it.
+/// </summary>
+class SpatialHashGrid
+{
+public:
+	SpatialHashGrid(float cellSize = 1.0f);
+	void SetCellSize(float cellSize);
+	float GetCellSize() const;
+
+	void Build(const float* x, const float* y, const float* z, size_t count);
+	void Build(const vector<vec3>& positions);
+
+	void QueryRadius(vec3 centre, float radius, vector<unsigned int>& results) const;
+	int FindNearest(vec3 point, float maxDistance, int excludeIndex = -1) const;
+	void FindPairs(float radius, vector<pair<unsigned int, unsigned int>>& pairs) const;
+
+	vec3 PositionOf(unsigned int index) const;
+	size_t Size() const;
+
+private:
+	float cellSize;
+	float inverseCellSize;
+	//Always a power of two so the hash can be masked
+	unsigned int tableMask = 0;
+
+	//--- Built data
+	//Bucket b holds sortedIndices[cellStart[b]] to sortedIndices[cellStart[b + 1]]
+	vector<unsigned int> cellStart;
+	vector<unsigned int> sortedIndices;
+	//Positions copied in bucket order so a query reads neighbouring memory, plus the original order for PositionOf
+	vector<vec3> sortedPositions;
+	vector<ivec3> sortedCells;
+	vector<vec3> positions;
+	vector<ivec3> itemCell;
+	vector<unsigned int> itemBucket;
+
+	ivec3 CellOf(vec3 position) const;
+	unsigned int BucketOf(ivec3 cell) const;
+	void SortIntoBuckets();
+	void VisitCell(ivec3 cell, vec3 point, int excludeIndex, int& bestIndex, float& bestDistanceSquared) const;
+};
@@ -0,0 +1,177 @@
+#include "StaticLightBake.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PointLightBuffer.h"
+
+StaticLightBake::StaticLightBake() {
+}
+
+/// <summary>
+/// Adds a light to bake, before any of the Bake calls. Only its position and attenuation are kept,
+/// its colours just set the range it fades out at, the same range PointLightBuffer would give it.
+/// </summary>
+void StaticLightBake::AddLight(const PointLight& light) {
+	lights.push_back({ light.position, light.constant, light.linear, light.quadratic, PointLightBuffer::LightRange(light) });
+}
+
+/// <summary>
+/// Shadows the diffuse sum with a cache whose lights are the ones added here in the same order, after ReadBack has been called on it
+/// </summary>
+void StaticLightBake::SetShadows(const ShadowCubeCache* shadows) {
+	this->shadows = shadows;
+}
+
+/// <summary>
+/// Bakes one mesh drawn with one model matrix
+/// </summary>
+/// <returns>Bake id to pass to Apply</returns>
+int StaticLightBake::BakeMesh(const Mesh& mesh, const mat4& model) {
+	bakes.push_back(ivec2((int)vertexLighting.size(), 0));
+	BakeVertices(mesh, model);
+	return (int)bakes.size() - 1;
+}
+
+/// <summary>
+/// Bakes every mesh of a model, each mesh is drawn on its own so gets its own id
+/// </summary>
+/// <returns>Bake id of the first mesh, the rest follow on in mesh order</returns>
+int StaticLightBake::BakeModel(const Model& model, const mat4& modelMatrix) {
+	int first = (int)bakes.size();
+	for (const Mesh& mesh : model.meshes)
+	{
+		BakeMesh(mesh, modelMatrix);
+	}
+	return first;
+}
+
+/// <summary>
+/// Bakes a mesh drawn instanced, one block of vertices per instance in instance order
+/// </summary>
+/// <returns>Bake id to pass to Apply</returns>
+int StaticLightBake::BakeInstances(const Mesh& mesh, const mat4* instanceMatrices, int instanceCount) {
+	bakes.push_back(ivec2((int)vertexLighting.size(), (int)mesh.vertices.size()));
+	for (int i = 0; i < instanceCount; i++)
+	{
+		BakeVertices(mesh, instanceMatrices[i]);
+	}
+	return (int)bakes.size() - 1;
+}
+
+/// <summary>
+/// Bakes the lightmap for a quad spanning -0.5 to 0.5 in x and y, texture coordinates 0 to 1 across it.
+/// Texels sit at their centres the way GL_LINEAR samples them.
+/// </summary>
+/// <param name="model">Quad's model matrix</param>
+/// <param name="normal">World space normal the quad is lit with, passed in as the floor quad has no normals of its own</param>
+void StaticLightBake::BakeLightMap(ivec2 resolution, const mat4& model, vec3 normal) {
+	lightMapResolution = resolution;
+	lightMap.resize((size_t)resolution.x * resolution.y);
+
+	vec3 corner = vec3(model * vec4(-0.5f, -0.5f, 0.0f, 1.0f));
+	vec3 uAxis = vec3(model * vec4(1.0f, 0.0f, 0.0f, 0.0f));
+	vec3 vAxis = vec3(model * vec4(0.0f, 1.0f, 0.0f, 0.0f));
+	normal = normalize(normal);
+
+	for (int y = 0; y < resolution.y; y++)
+	{
+		for (int x = 0; x < resolution.x; x++)
+		{
+			vec2 texCoord = (vec2(x, y) + 0.5f) / vec2(resolution);
+			lightMap[(size_t)y * resolution.x + x] = Lighting(corner + texCoord.x * uAxis + texCoord.y * vAxis, normal);
+		}
+	}
+}
+
+/// <summary>
+/// Sends the baked vertices and lightmap to the GPU once every bake is done, each left bound to its unit. Needs a current GL context.
+/// </summary>
+void StaticLightBake::Upload(int vertexTextureUnit, int lightMapTextureUnit) {
+	this->vertexTextureUnit = vertexTextureUnit;
+	this->lightMapTextureUnit = lightMapTextureUnit;
+
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, vertexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, vertexLighting.size() * sizeof(vec2), vertexLighting.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &vertexTexture);
+	glActiveTexture(GL_TEXTURE0 + vertexTextureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, vertexBuffer);
+
+	glGenTextures(1, &lightMapTexture);
+	glActiveTexture(GL_TEXTURE0 + lightMapTextureUnit);
+	glBindTexture(GL_TEXTURE_2D, lightMapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, lightMapResolution.x, lightMapResolution.y, 0, GL_RG, GL_FLOAT, lightMap.empty() ? NULL : lightMap.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void StaticLightBake::Attach(Shader& shader) const {
+	shader.Use();
+	shader.setInt("staticLightVertices", vertexTextureUnit);
+	shader.setInt("staticLightMap", lightMapTextureUnit);
+}
+
+/// <summary>
+/// Points the model shader at one bake's vertices through its "staticLightBake" uniform, -1 for a draw that has none. The shader must be in use.
+/// </summary>
+void StaticLightBake::Apply(const UniformHandle<ivec2>& bakeUniform, int bake) const {
+	bakeUniform.Set(bake < 0 ? ivec2(-1, 0) : bakes[bake]);
+}
+
+void StaticLightBake::CleanUp() {
+	glDeleteTextures(1, &vertexTexture);
+	glDeleteTextures(1, &lightMapTexture);
+	glDeleteBuffers(1, &vertexBuffer);
+	vertexTexture = lightMapTexture = vertexBuffer = 0;
+}
+
+size_t StaticLightBake::GetVertexCount() const {
+	return vertexLighting.size();
+}
+
+/// <summary>
+/// CalcPointLight's diffuse and ambient factors summed over every light, for a light colour of one
+/// </summary>
+vec2 StaticLightBake::Lighting(vec3 position, vec3 normal) const {
+	vec2 lighting = vec2(0.0f);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const BakedLight& light = lights[i];
+		vec3 toLight = light.position - position;
+		float distance = length(toLight);
+		if (distance >= light.range)
+		{
+			continue;
+		}
+
+		float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		//Same fade to nothing at the range as the shaders
+		float fade = glm::clamp(1.0f - powf(distance / std::max(light.range, 0.0001f), 4.0f), 0.0f, 1.0f);
+		attenuation *= fade * fade;
+
+		float diffuse = distance > 0.0f ? std::max(dot(normal, toLight / distance), 0.0f) : 0.0f;
+		if (shadows != NULL && diffuse > 0.0f)
+		{
+			diffuse *= shadows->Visibility((int)i, position);
+		}
+		lighting += vec2(diffuse * attenuation, attenuation);
+	}
+	return lighting;
+}
+
+void StaticLightBake::BakeVertices(const Mesh& mesh, const mat4& model) {
+	mat3 normalMatrix = transpose(inverse(mat3(model)));
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		vec3 position = vec3(model * vec4(vertex.Position, 1.0f));
+		vec3 normal = normalMatrix * vertex.Normal;
+		float normalLength = length(normal);
+		vertexLighting.push_back(Lighting(position, normalLength > 0.0f ? normal / normalLength : vec3(0.0f)));
+	}
+}
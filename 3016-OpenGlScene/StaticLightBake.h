@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "Model.h"
+#include "PointLight.h"
+#include "Shader.h"
+#include "ShadowCubeCache.h"
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Lighting from lights that never move, worked out once at startup so the lit shaders don't loop over them.
+/// Each baked point stores two sums over the lights, x is diffuse (the N dot L term times attenuation) and y is
+/// ambient (attenuation alone). The lights must share one colour, the shaders multiply the sums by it each frame,
+/// so the lamps can still flicker. Specular depends on the view and isn't baked, baked lights have none.
+/// Models are baked per vertex into one buffer texture the model vertex shader reads by gl_VertexID.
+/// The floor quad only has four vertices, far too few for a lamp's pool of light, so it gets a lightmap over its texture coordinates.
+/// Given a shadow cache, the diffuse sum is shadowed by it. Ambient is left unshadowed as the shaders leave it.
+/// </summary>
+class StaticLightBake
+{
+public:
+	StaticLightBake();
+	void AddLight(const PointLight& light);
+	void SetShadows(const ShadowCubeCache* shadows);
+
+	int BakeMesh(const Mesh& mesh, const mat4& model);
+	int BakeModel(const Model& model, const mat4& modelMatrix);
+	int BakeInstances(const Mesh& mesh, const mat4* instanceMatrices, int instanceCount);
+	void BakeLightMap(ivec2 resolution, const mat4& model, vec3 normal);
+
+	void Upload(int vertexTextureUnit, int lightMapTextureUnit);
+	void Attach(Shader& shader) const;
+	void Apply(const UniformHandle<ivec2>& bakeUniform, int bake) const;
+	void CleanUp();
+
+	size_t GetVertexCount() const;
+
+private:
+	struct BakedLight
+	{
+		vec3 position;
+		float constant;
+		float linear;
+		float quadratic;
+		float range;
+	};
+	vector<BakedLight> lights;
+	//Read back shadows of the lights in the order they were added, NULL for none
+	const ShadowCubeCache* shadows = NULL;
+
+	//Per bake, x offset into vertexLighting and y vertices per instance, 0 when it isn't instanced
+	vector<ivec2> bakes;
+	vector<vec2> vertexLighting;
+
+	ivec2 lightMapResolution = ivec2(0);
+	vector<vec2> lightMap;
+
+	int vertexTextureUnit = 0;
+	int lightMapTextureUnit = 0;
+	unsigned int vertexBuffer = 0;
+	unsigned int vertexTexture = 0;
+	unsigned int lightMapTexture = 0;
+
+	vec2 Lighting(vec3 position, vec3 normal) const;
+	void BakeVertices(const Mesh& mesh, const mat4& model);
+};
@@ -0,0 +1,226 @@
+#include "WindField.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "FastNoiseLite.h"
+
+//--- Same SIMD selection as ProjectileParticleStore, a node's four floats are blended as one register
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WIND_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+WindField::WindField() {
+}
+
+/// <summary>
+/// Bakes the curl of three noise fields into the grid. The potential is baked first with a border of one node, then
+/// the curl is taken by central differences, so the grid's own divergence is zero up to rounding.
+/// </summary>
+/// <param name="resolution">Nodes along each axis, at least 2</param>
+/// <param name="origin">Lowest corner of the box the grid covers, positions outside take the nearest edge's wind</param>
+/// <param name="extent">Size of the box</param>
+/// <param name="frequency">Noise frequency, lower gives broader swirls</param>
+/// <param name="strength">Speed of the fastest gust, the whole field is scaled so its largest wind is this</param>
+void WindField::Bake(int seed, ivec3 resolution, vec3 origin, vec3 extent, float frequency, float strength) {
+	this->resolution = resolution;
+	this->origin = origin;
+	this->extent = extent;
+	cellSize = extent / vec3(resolution);
+
+	//--- Vector potential, one noise per component
+	FastNoiseLite potentialNoise[3];
+	for (int c = 0; c < 3; c++)
+	{
+		potentialNoise[c].SetSeed(seed + c);
+		potentialNoise[c].SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+		potentialNoise[c].SetFrequency(frequency);
+	}
+
+	ivec3 padded = resolution + 2;
+	vector<vec3> potential((size_t)padded.x * padded.y * padded.z);
+	for (int z = 0; z < padded.z; z++)
+	{
+		for (int y = 0; y < padded.y; y++)
+		{
+			for (int x = 0; x < padded.x; x++)
+			{
+				//Padded node 0 is the border node just outside grid node 0
+				vec3 nodePosition = origin + (vec3(x, y, z) - 0.5f) * cellSize;
+				vec3& value = potential[((size_t)z * padded.y + y) * padded.x + x];
+				for (int c = 0; c < 3; c++)
+				{
+					value[c] = potentialNoise[c].GetNoise(nodePosition.x, nodePosition.y, nodePosition.z);
+				}
+			}
+		}
+	}
+
+	auto potentialAt = [&](int x, int y, int z) -> const vec3& {
+		return potential[((size_t)(z + 1) * padded.y + (y + 1)) * padded.x + (x + 1)];
+	};
+
+	//--- Curl
+	velocities.assign((size_t)resolution.x * resolution.y * resolution.z, vec4(0.0f));
+	vec3 twoCells = 2.0f * cellSize;
+	float fastest = 0.0f;
+	for (int z = 0; z < resolution.z; z++)
+	{
+		for (int y = 0; y < resolution.y; y++)
+		{
+			for (int x = 0; x < resolution.x; x++)
+			{
+				vec3 dx = (potentialAt(x + 1, y, z) - potentialAt(x - 1, y, z)) / twoCells.x;
+				vec3 dy = (potentialAt(x, y + 1, z) - potentialAt(x, y - 1, z)) / twoCells.y;
+				vec3 dz = (potentialAt(x, y, z + 1) - potentialAt(x, y, z - 1)) / twoCells.z;
+
+				vec3 curl = vec3(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x);
+				velocities[NodeIndex(x, y, z)] = vec4(curl, 0.0f);
+				fastest = std::max(fastest, length(curl));
+			}
+		}
+	}
+
+	float scale = fastest > 0.0f ? strength / fastest : 0.0f;
+	for (vec4& velocity : velocities)
+	{
+		velocity *= scale;
+	}
+}
+
+/// <summary>
+/// Trilinear wind at a position, nodes sit at cell centres the way texels do
+/// </summary>
+vec3 WindField::Sample(vec3 position) const {
+	vec3 gridPosition = clamp((position - origin) / cellSize - 0.5f, vec3(0.0f), vec3(resolution - 1));
+	ivec3 cell = min(ivec3(gridPosition), resolution - 2);
+	vec3 f = gridPosition - vec3(cell);
+
+	size_t i = NodeIndex(cell.x, cell.y, cell.z);
+	size_t strideY = resolution.x;
+	size_t strideZ = (size_t)resolution.x * resolution.y;
+
+	vec4 bottomFront = mix(velocities[i], velocities[i + 1], f.x);
+	vec4 topFront = mix(velocities[i + strideY], velocities[i + strideY + 1], f.x);
+	vec4 bottomBack = mix(velocities[i + strideZ], velocities[i + strideZ + 1], f.x);
+	vec4 topBack = mix(velocities[i + strideZ + strideY], velocities[i + strideZ + strideY + 1], f.x);
+
+	return vec3(mix(mix(bottomFront, topFront, f.y), mix(bottomBack, topBack, f.y), f.z));
+}
+
+#if defined(WIND_SIMD_SSE)
+static inline __m128 Lerp(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+#endif
+
+/// <summary>
+/// Sample for a whole array of positions, laid out the way ProjectileParticleStore holds them.
+/// Each of the eight corner nodes is one 4 float load, and the blends work on all three components at once.
+/// </summary>
+void WindField::SampleBatch(const float* x, const float* y, const float* z, size_t count, float* outX, float* outY, float* outZ) const {
+#if defined(WIND_SIMD_SSE)
+	size_t strideY = resolution.x;
+	size_t strideZ = (size_t)resolution.x * resolution.y;
+	const float* nodes = &velocities[0].x;
+
+	for (size_t n = 0; n < count; n++)
+	{
+		vec3 gridPosition = clamp((vec3(x[n], y[n], z[n]) - origin) / cellSize - 0.5f, vec3(0.0f), vec3(resolution - 1));
+		ivec3 cell = min(ivec3(gridPosition), resolution - 2);
+		vec3 f = gridPosition - vec3(cell);
+
+		__m128 fx = _mm_set1_ps(f.x);
+		__m128 fy = _mm_set1_ps(f.y);
+		__m128 fz = _mm_set1_ps(f.z);
+
+		const float* front = nodes + NodeIndex(cell.x, cell.y, cell.z) * 4;
+		const float* back = front + strideZ * 4;
+
+		__m128 bottomFront = Lerp(_mm_loadu_ps(front), _mm_loadu_ps(front + 4), fx);
+		__m128 topFront = Lerp(_mm_loadu_ps(front + strideY * 4), _mm_loadu_ps(front + strideY * 4 + 4), fx);
+		__m128 bottomBack = Lerp(_mm_loadu_ps(back), _mm_loadu_ps(back + 4), fx);
+		__m128 topBack = Lerp(_mm_loadu_ps(back + strideY * 4), _mm_loadu_ps(back + strideY * 4 + 4), fx);
+
+		float wind[4];
+		_mm_storeu_ps(wind, Lerp(Lerp(bottomFront, topFront, fy), Lerp(bottomBack, topBack, fy), fz));
+		outX[n] = wind[0];
+		outY[n] = wind[1];
+		outZ[n] = wind[2];
+	}
+#else
+	for (size_t n = 0; n < count; n++)
+	{
+		vec3 wind = Sample(vec3(x[n], y[n], z[n]));
+		outX[n] = wind.x;
+		outY[n] = wind.y;
+		outZ[n] = wind.z;
+	}
+#endif
+}
+
+/// <summary>
+/// Largest central difference divergence over the inner nodes, relative to the fastest wind over one cell.
+/// For checking the bake, it should be down at rounding error.
+/// </summary>
+float WindField::MaxDivergence() const {
+	float largest = 0.0f;
+	float fastest = 0.0f;
+	for (int z = 1; z < resolution.z - 1; z++)
+	{
+		for (int y = 1; y < resolution.y - 1; y++)
+		{
+			for (int x = 1; x < resolution.x - 1; x++)
+			{
+				float divergence = (velocities[NodeIndex(x + 1, y, z)].x - velocities[NodeIndex(x - 1, y, z)].x) / (2.0f * cellSize.x)
+					+ (velocities[NodeIndex(x, y + 1, z)].y - velocities[NodeIndex(x, y - 1, z)].y) / (2.0f * cellSize.y)
+					+ (velocities[NodeIndex(x, y, z + 1)].z - velocities[NodeIndex(x, y, z - 1)].z) / (2.0f * cellSize.z);
+				largest = std::max(largest, std::abs(divergence));
+				fastest = std::max(fastest, length(vec3(velocities[NodeIndex(x, y, z)])));
+			}
+		}
+	}
+
+	float smallestCell = std::min(cellSize.x, std::min(cellSize.y, cellSize.z));
+	return fastest > 0.0f ? largest * smallestCell / fastest : 0.0f;
+}
+
+/// <summary>
+/// Uploads the grid as a half float 3D texture and leaves it bound to textureUnit. Needs a current GL context.
+/// </summary>
+void WindField::CreateTexture(int textureUnit) {
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_3D, texture);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA16F, resolution.x, resolution.y, resolution.z, 0, GL_RGBA, GL_FLOAT, velocities.data());
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void WindField::CleanUp() {
+	if (texture != 0)
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+}
+
+unsigned int WindField::GetTexture() const {
+	return texture;
+}
+
+vec3 WindField::GetOrigin() const {
+	return origin;
+}
+
+vec3 WindField::GetExtent() const {
+	return extent;
+}
+
+size_t WindField::NodeIndex(int x, int y, int z) const {
+	return ((size_t)z * resolution.y + y) * resolution.x + x;
+}
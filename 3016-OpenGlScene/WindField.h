@@ -0,0 +1,47 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+using namespace glm;
+using namespace std;
+
+/// <summary>
+/// Turbulent wind for the bubbles to drift on, baked once into a grid so a bubble costs one trilinear lookup
+/// rather than three noise evaluations and their derivatives.
+/// The wind is the curl of a noise vector potential. A curl has no divergence, so bubbles swirl around each other
+/// rather than bunching up in sinks or spreading out from sources.
+/// The same grid goes to the GPU as a 3D texture. Sample matches GL_LINEAR with clamp to edge, so the CPU and GPU
+/// simulations drift the same way.
+/// </summary>
+class WindField
+{
+public:
+	WindField();
+	void Bake(int seed, ivec3 resolution, vec3 origin, vec3 extent, float frequency, float strength);
+	vec3 Sample(vec3 position) const;
+	void SampleBatch(const float* x, const float* y, const float* z, size_t count, float* outX, float* outY, float* outZ) const;
+	float MaxDivergence() const;
+
+	void CreateTexture(int textureUnit);
+	void CleanUp();
+
+	unsigned int GetTexture() const;
+	vec3 GetOrigin() const;
+	vec3 GetExtent() const;
+
+private:
+	ivec3 resolution = ivec3(0);
+	vec3 origin = vec3(0.0f);
+	vec3 extent = vec3(0.0f);
+	vec3 cellSize = vec3(1.0f);
+
+	//One wind velocity per grid node, x fastest then y then z. w is padding so a node loads as one 4 float block.
+	vector<vec4> velocities;
+	unsigned int texture = 0;
+
+	size_t NodeIndex(int x, int y, int z) const;
+};